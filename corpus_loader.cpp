@@ -0,0 +1,202 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw system_error(errno, generic_category(), "Cannot open corpus "s + path);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) < 0) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "Cannot stat corpus "s + path);
+        }
+        size_ = file_stat.st_size;
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                const int error = errno;
+                close(fd);
+                throw system_error(error, generic_category(), "Cannot map corpus "s + path);
+            }
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    string_view Data() const {
+        return { data_, size_ };
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Рейтинги всех строк куска лежат в одном массиве, строка хранит свой участок
+struct ParsedLine {
+    size_t line;
+    int document_id;
+    DocumentStatus status;
+    size_t ratings_begin;
+    size_t ratings_end;
+    string_view text;
+};
+
+struct ParsedChunk {
+    vector<ParsedLine> lines;
+    vector<int> ratings;
+    vector<CorpusError> errors;
+    size_t line_count = 0;
+};
+
+string_view NextField(string_view& line) {
+    const size_t tab = line.find('\t');
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab == string_view::npos ? line.size() : tab + 1);
+    return field;
+}
+
+bool ParseInt(string_view text, int& value) {
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size() && !text.empty();
+}
+
+bool ParseRatings(string_view text, vector<int>& ratings) {
+    while (true) {
+        const size_t begin = text.find_first_not_of(' ');
+        if (begin == string_view::npos) {
+            return true;
+        }
+        text.remove_prefix(begin);
+        int rating;
+        const auto [end, error] = from_chars(text.data(), text.data() + text.size(), rating);
+        if (error != errc() || (end != text.data() + text.size() && *end != ' ')) {
+            return false;
+        }
+        ratings.push_back(rating);
+        text.remove_prefix(end - text.data());
+    }
+}
+
+void ParseChunk(string_view chunk, ParsedChunk& result) {
+    size_t line_number = 0;
+    while (!chunk.empty()) {
+        const size_t end_of_line = chunk.find('\n');
+        string_view line = chunk.substr(0, end_of_line);
+        chunk.remove_prefix(end_of_line == string_view::npos ? chunk.size() : end_of_line + 1);
+        ++line_number;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        const string_view id_field = NextField(line);
+        const string_view status_field = NextField(line);
+        const string_view ratings_field = NextField(line);
+        int document_id;
+        int status;
+        if (!ParseInt(id_field, document_id)) {
+            result.errors.push_back({ line_number, "Invalid document id "s + string(id_field) });
+            continue;
+        }
+        if (!ParseInt(status_field, status) || status < 0 || status > static_cast<int>(DocumentStatus::REMOVED)) {
+            result.errors.push_back({ line_number, "Invalid document status "s + string(status_field) });
+            continue;
+        }
+        const size_t ratings_begin = result.ratings.size();
+        if (!ParseRatings(ratings_field, result.ratings)) {
+            result.ratings.resize(ratings_begin);
+            result.errors.push_back({ line_number, "Invalid ratings "s + string(ratings_field) });
+            continue;
+        }
+        result.lines.push_back({ line_number, document_id, static_cast<DocumentStatus>(status), ratings_begin, result.ratings.size(), line });
+    }
+    result.line_count = line_number;
+}
+
+// Граница куска сдвигается к началу следующей строки
+vector<string_view> SplitIntoChunks(string_view data, size_t chunk_size) {
+    vector<string_view> chunks;
+    while (!data.empty()) {
+        size_t end = min(chunk_size, data.size());
+        if (end < data.size()) {
+            const size_t end_of_line = data.find('\n', end - 1);
+            end = end_of_line == string_view::npos ? data.size() : end_of_line + 1;
+        }
+        chunks.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+    }
+    return chunks;
+}
+
+}
+
+CorpusLoadResult LoadCorpus(SearchServer& search_server, string_view data, TaskScheduler& scheduler) {
+    const vector<string_view> chunks = SplitIntoChunks(data, CORPUS_CHUNK_SIZE);
+    vector<ParsedChunk> parsed(chunks.size());
+    scheduler.ParallelFor(0, chunks.size(), 1, [&chunks, &parsed](size_t index) {
+        ParseChunk(chunks[index], parsed[index]);
+        });
+
+    CorpusLoadResult result;
+    size_t first_line = 0;
+    vector<int> ratings;
+    for (ParsedChunk& chunk : parsed) {
+        for (const ParsedLine& line : chunk.lines) {
+            ratings.assign(chunk.ratings.begin() + line.ratings_begin, chunk.ratings.begin() + line.ratings_end);
+            try {
+                search_server.AddDocument(line.document_id, line.text, line.status, ratings);
+                ++result.loaded;
+            }
+            catch (const exception& e) {
+                chunk.errors.push_back({ line.line, e.what() });
+            }
+        }
+        sort(chunk.errors.begin(), chunk.errors.end(), [](const CorpusError& lhs, const CorpusError& rhs) {
+            return lhs.line < rhs.line;
+            });
+        for (CorpusError& error : chunk.errors) {
+            error.line += first_line;
+            result.errors.push_back(move(error));
+        }
+        first_line += chunk.line_count;
+    }
+    return result;
+}
+
+CorpusLoadResult LoadCorpusFile(SearchServer& search_server, const string& path, TaskScheduler& scheduler) {
+    const MappedFile file(path);
+    return LoadCorpus(search_server, file.Data(), scheduler);
+}
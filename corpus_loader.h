@@ -0,0 +1,29 @@
+#pragma once
+#include "search_server.h"
+#include "task_scheduler.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Файл разбивается на куски примерно такого размера по границам строк
+const size_t CORPUS_CHUNK_SIZE = 4 * 1024 * 1024;
+
+struct CorpusError {
+    size_t line = 0;
+    std::string message;
+};
+
+struct CorpusLoadResult {
+    size_t loaded = 0;
+    std::vector<CorpusError> errors;
+};
+
+// Корпус - строки "id<TAB>статус<TAB>рейтинги через пробел<TAB>текст", статус - число от 0 до 3,
+// пустые строки пропускаются. Куски разбираются параллельно в scheduler, поля ссылаются на исходные
+// данные без копирования, документы добавляются в сервер в порядке строк. Ошибочные строки
+// (в том числе отвергнутые AddDocument) не прерывают загрузку и возвращаются с номерами по возрастанию
+CorpusLoadResult LoadCorpus(SearchServer& search_server, std::string_view data, TaskScheduler& scheduler = TaskScheduler::Default());
+
+// Отображает файл в память; если файл не открывается, бросает std::system_error
+CorpusLoadResult LoadCorpusFile(SearchServer& search_server, const std::string& path, TaskScheduler& scheduler = TaskScheduler::Default());
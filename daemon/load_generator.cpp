@@ -0,0 +1,184 @@
+// Генератор нагрузки для search_daemon: каждое соединение держит depth запросов в полёте
+// (замкнутый цикл) и меряет задержку от отправки запроса до получения ответа
+//
+// load_generator ADDRESS --queries FILE [--connections C] [--depth D] [--seconds S]
+// FILE - по запросу FindTopDocuments на строку
+
+#include "search_protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+struct ConnectionResult {
+    vector<uint32_t> latencies_us;
+    size_t errors = 0;
+    size_t partial = 0;
+};
+
+void SendAll(int fd, const vector<char>& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            throw runtime_error("Send failed"s);
+        }
+        sent += result;
+    }
+}
+
+ConnectionResult RunConnection(const string& address, const vector<string>& queries, size_t first_query,
+    size_t depth, steady_clock::time_point deadline) {
+    ConnectionResult result;
+    const int fd = ConnectToServer(address);
+    deque<steady_clock::time_point> sent_at;
+    vector<char> output;
+    vector<char> input;
+    size_t input_begin = 0;
+    size_t next_query = first_query;
+    uint32_t request_id = 0;
+
+    auto send_request = [&] {
+        output.clear();
+        WriteFindTopDocumentsRequest(output, request_id++, DocumentStatus::ACTUAL, queries[next_query++ % queries.size()]);
+        sent_at.push_back(steady_clock::now());
+        SendAll(fd, output);
+    };
+
+    for (size_t i = 0; i < depth; ++i) {
+        send_request();
+    }
+    while (!sent_at.empty()) {
+        const size_t size = input.size();
+        input.resize(size + 64 * 1024);
+        const ssize_t received = recv(fd, input.data() + size, 64 * 1024, 0);
+        if (received <= 0) {
+            close(fd);
+            throw runtime_error("Connection closed by server"s);
+        }
+        input.resize(size + received);
+
+        Response response;
+        while (const size_t frame_size = ParseResponse({ input.data() + input_begin, input.size() - input_begin }, response)) {
+            input_begin += frame_size;
+            const auto now = steady_clock::now();
+            result.latencies_us.push_back(static_cast<uint32_t>(duration_cast<microseconds>(now - sent_at.front()).count()));
+            sent_at.pop_front();
+            if (response.status == ResponseStatus::PARTIAL) {
+                ++result.partial;
+            }
+            else if (response.status != ResponseStatus::OK) {
+                ++result.errors;
+            }
+            if (now < deadline) {
+                send_request();
+            }
+        }
+        input.erase(input.begin(), input.begin() + input_begin);
+        input_begin = 0;
+    }
+    close(fd);
+    return result;
+}
+
+uint32_t Percentile(const vector<uint32_t>& sorted, double fraction) {
+    const size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+    return sorted[index];
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: "s << argv[0] << " ADDRESS --queries FILE [--connections C] [--depth D] [--seconds S]"s << endl;
+        return 1;
+    }
+    const string address = argv[1];
+    string queries_path;
+    size_t connection_count = 4;
+    size_t depth = 8;
+    double seconds = 5;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        if (option == "--queries"s) {
+            queries_path = argv[i + 1];
+        }
+        else if (option == "--connections"s) {
+            connection_count = stoul(argv[i + 1]);
+        }
+        else if (option == "--depth"s) {
+            depth = stoul(argv[i + 1]);
+        }
+        else if (option == "--seconds"s) {
+            seconds = stod(argv[i + 1]);
+        }
+    }
+
+    vector<string> queries;
+    ifstream input(queries_path);
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+    if (queries.empty()) {
+        cerr << "No queries in "s << queries_path << endl;
+        return 1;
+    }
+
+    const auto start = steady_clock::now();
+    const auto deadline = start + duration_cast<steady_clock::duration>(duration<double>(seconds));
+    vector<ConnectionResult> results(connection_count);
+    atomic_size_t failed = 0;
+    vector<thread> threads;
+    for (size_t i = 0; i < connection_count; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                results[i] = RunConnection(address, queries, i * queries.size() / connection_count, depth, deadline);
+            }
+            catch (const exception& e) {
+                cerr << e.what() << endl;
+                ++failed;
+            }
+            });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    const double elapsed = duration<double>(steady_clock::now() - start).count();
+
+    vector<uint32_t> latencies;
+    size_t errors = 0;
+    size_t partial = 0;
+    for (const ConnectionResult& result : results) {
+        latencies.insert(latencies.end(), result.latencies_us.begin(), result.latencies_us.end());
+        errors += result.errors;
+        partial += result.partial;
+    }
+    if (latencies.empty()) {
+        cerr << "No responses"s << endl;
+        return 1;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "requests: "s << latencies.size() << ", partial: "s << partial << ", errors: "s << errors << ", failed connections: "s << failed << endl;
+    cout << "throughput: "s << static_cast<size_t>(latencies.size() / elapsed) << " req/s"s << endl;
+    cout << "latency us: p50 "s << Percentile(latencies, 0.5) << ", p90 "s << Percentile(latencies, 0.9)
+        << ", p99 "s << Percentile(latencies, 0.99) << ", p99.9 "s << Percentile(latencies, 0.999)
+        << ", max "s << latencies.back() << endl;
+    return 0;
+}
@@ -0,0 +1,468 @@
+// Поисковый сервер: держит индекс SearchServer в памяти и обслуживает запросы двоичного
+// протокола (search_protocol.h). Один поток с epoll принимает соединения, читает и пишет сокеты,
+// запросы выполняет фиксированный пул рабочих потоков
+//
+// search_daemon ADDRESS [--workers N] [--stop-words "and with"] [--corpus FILE] [--memory-budget BYTES] [--deadline-us MICROSECONDS]
+// Срок поиска отсчитывается от получения запроса, время в очереди рабочих потоков входит в него
+// ADDRESS - unix:/path/to/socket или host:port. FILE - строки "id<TAB>статус<TAB>рейтинги через пробел<TAB>текст"
+
+#include "search_protocol.h"
+#include "../corpus_loader.h"
+#include "../search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+const int MAX_EVENTS = 256;
+const int MAX_IOVEC = 64;
+
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t thread_count) {
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this] {
+                Run();
+            });
+        }
+    }
+
+    ~WorkerPool() {
+        Stop();
+    }
+
+    // Ждёт, пока будут выполнены все поставленные задачи, и останавливает потоки
+    void Stop() {
+        {
+            lock_guard guard(mutex_);
+            stopped_ = true;
+        }
+        condition_.notify_all();
+        for (thread& worker : threads_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    void Submit(function<void()> task) {
+        {
+            lock_guard guard(mutex_);
+            tasks_.push_back(move(task));
+        }
+        condition_.notify_one();
+    }
+
+private:
+    void Run() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock lock(mutex_);
+                condition_.wait(lock, [this] {
+                    return stopped_ || !tasks_.empty();
+                    });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    vector<thread> threads_;
+    deque<function<void()>> tasks_;
+    mutex mutex_;
+    condition_variable condition_;
+    bool stopped_ = false;
+};
+
+// Ответ, который заполняет рабочий поток. Поле ready трогает только поток epoll
+struct PendingResponse {
+    vector<char> data;
+    bool ready = false;
+};
+
+struct Connection {
+    int fd = -1;
+    bool closed = false;
+    size_t in_flight = 0;
+    vector<char> input;
+    size_t input_begin = 0;
+    // Ответы в порядке запросов; готовый префикс отправляется через writev без склейки
+    deque<PendingResponse> responses;
+    size_t sent_in_front = 0;
+    bool want_write = false;
+};
+
+struct Completion {
+    uint64_t connection_id;
+    PendingResponse* response;
+};
+
+class SearchDaemon {
+public:
+    SearchDaemon(SearchServer& search_server, int listen_fd, size_t worker_count, chrono::microseconds search_timeout)
+        : search_server_(search_server)
+        , search_timeout_(search_timeout)
+        , listen_fd_(listen_fd)
+        , epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+        , wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , workers_(worker_count) {
+        Watch(listen_fd_, EPOLLIN, LISTEN_TAG);
+        Watch(wakeup_fd_, EPOLLIN, WAKEUP_TAG);
+    }
+
+    // Задачи рабочих потоков пишут в wakeup_fd_ и в ответы соединений, поэтому пул
+    // останавливается раньше, чем закрываются дескрипторы
+    ~SearchDaemon() {
+        workers_.Stop();
+        close(wakeup_fd_);
+        close(epoll_fd_);
+    }
+
+    void Run(const atomic_bool& stop) {
+        epoll_event events[MAX_EVENTS];
+        while (!stop) {
+            const int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, 100);
+            for (int i = 0; i < count; ++i) {
+                const uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG) {
+                    AcceptConnections();
+                }
+                else if (tag == WAKEUP_TAG) {
+                    DrainCompletions();
+                }
+                else {
+                    HandleConnection(tag, events[i].events);
+                }
+            }
+        }
+    }
+
+private:
+    static const uint64_t LISTEN_TAG = 0;
+    static const uint64_t WAKEUP_TAG = 1;
+
+    void Watch(int fd, uint32_t events, uint64_t tag, int operation = EPOLL_CTL_ADD) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epoll_fd_, operation, fd, &event);
+    }
+
+    void AcceptConnections() {
+        while (true) {
+            const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            const uint64_t id = next_connection_id_++;
+            auto connection = make_unique<Connection>();
+            connection->fd = fd;
+            connections_.emplace(id, move(connection));
+            Watch(fd, EPOLLIN | EPOLLRDHUP, id);
+        }
+    }
+
+    void HandleConnection(uint64_t id, uint32_t events) {
+        const auto it = connections_.find(id);
+        if (it == connections_.end() || it->second->closed) {
+            return;
+        }
+        Connection& connection = *it->second;
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            Close(connection);
+        }
+        else {
+            if (events & EPOLLIN) {
+                ReadRequests(id, connection);
+            }
+            if (!connection.closed && (events & EPOLLOUT)) {
+                Flush(id, connection);
+            }
+        }
+        if (connection.closed && connection.in_flight == 0) {
+            connections_.erase(it);
+        }
+    }
+
+    void ReadRequests(uint64_t id, Connection& connection) {
+        while (true) {
+            const size_t size = connection.input.size();
+            connection.input.resize(size + READ_CHUNK_SIZE);
+            const ssize_t received = recv(connection.fd, connection.input.data() + size, READ_CHUNK_SIZE, 0);
+            connection.input.resize(size + max<ssize_t>(received, 0));
+            if (received == 0) {
+                Close(connection);
+                return;
+            }
+            if (received < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    Close(connection);
+                    return;
+                }
+                break;
+            }
+        }
+
+        try {
+            Request request;
+            while (true) {
+                const span<const char> unread(connection.input.data() + connection.input_begin, connection.input.size() - connection.input_begin);
+                const size_t frame_size = ParseRequest(unread, request);
+                if (frame_size == 0) {
+                    break;
+                }
+                connection.input_begin += frame_size;
+                Dispatch(id, connection, request);
+            }
+        }
+        catch (const invalid_argument&) {
+            Close(connection);
+            return;
+        }
+        connection.input.erase(connection.input.begin(), connection.input.begin() + connection.input_begin);
+        connection.input_begin = 0;
+    }
+
+    // Текст запроса копируется в задачу: входной буфер соединения может быть перезаписан раньше,
+    // чем рабочий поток до него доберётся
+    void Dispatch(uint64_t id, Connection& connection, const Request& request) {
+        PendingResponse* response = &connection.responses.emplace_back();
+        ++connection.in_flight;
+        const auto deadline = search_timeout_.count() > 0 ? chrono::steady_clock::now() + search_timeout_ : chrono::steady_clock::time_point::max();
+        workers_.Submit([this, id, response, deadline, request_id = request.request_id, type = request.type,
+            document_id = request.document_id, status = request.status, ratings = request.ratings, text = string(request.text)] {
+            try {
+                Execute(response->data, request_id, type, document_id, status, ratings, text, deadline);
+            }
+            catch (const exception& e) {
+                response->data.clear();
+                WriteErrorResponse(response->data, request_id, e.what());
+            }
+            {
+                lock_guard guard(completions_mutex_);
+                completions_.push_back({ id, response });
+            }
+            const uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(wakeup_fd_, &one, sizeof(one));
+            });
+    }
+
+    void Execute(vector<char>& out, uint32_t request_id, RequestType type, int document_id, DocumentStatus status,
+        const vector<int>& ratings, const string& text, chrono::steady_clock::time_point deadline) {
+        switch (type) {
+        case RequestType::FIND_TOP_DOCUMENTS: {
+            SearchOptions options;
+            options.deadline = deadline;
+            shared_lock lock(index_mutex_);
+            const SearchResult result = search_server_.Search(text, options, DocumentStatusIs{ status });
+            lock.unlock();
+            WriteDocumentsResponse(out, request_id, result.documents, result.is_partial);
+            break;
+        }
+        case RequestType::MATCH_DOCUMENT: {
+            // Слова ссылаются на индекс, поэтому сериализуются под той же блокировкой
+            shared_lock lock(index_mutex_);
+            const auto [words, document_status] = search_server_.MatchDocument(text, document_id);
+            WriteMatchResponse(out, request_id, words, document_status);
+            break;
+        }
+        case RequestType::ADD_DOCUMENT: {
+            unique_lock lock(index_mutex_);
+            search_server_.AddDocument(document_id, text, status, ratings);
+            lock.unlock();
+            WriteEmptyResponse(out, request_id);
+            break;
+        }
+        case RequestType::REMOVE_DOCUMENT: {
+            unique_lock lock(index_mutex_);
+            search_server_.RemoveDocument(document_id);
+            lock.unlock();
+            WriteEmptyResponse(out, request_id);
+            break;
+        }
+        }
+    }
+
+    void DrainCompletions() {
+        uint64_t counter;
+        [[maybe_unused]] const ssize_t drained = read(wakeup_fd_, &counter, sizeof(counter));
+        vector<Completion> completions;
+        {
+            lock_guard guard(completions_mutex_);
+            completions.swap(completions_);
+        }
+        for (const Completion& completion : completions) {
+            const auto it = connections_.find(completion.connection_id);
+            Connection& connection = *it->second;
+            completion.response->ready = true;
+            --connection.in_flight;
+            if (!connection.closed) {
+                Flush(completion.connection_id, connection);
+            }
+            if (connection.closed && connection.in_flight == 0) {
+                connections_.erase(it);
+            }
+        }
+    }
+
+    void Flush(uint64_t id, Connection& connection) {
+        while (!connection.responses.empty() && connection.responses.front().ready) {
+            iovec parts[MAX_IOVEC];
+            int part_count = 0;
+            for (auto it = connection.responses.begin(); it != connection.responses.end() && it->ready && part_count < MAX_IOVEC; ++it) {
+                const size_t offset = part_count == 0 ? connection.sent_in_front : 0;
+                parts[part_count++] = { it->data.data() + offset, it->data.size() - offset };
+            }
+            ssize_t sent = writev(connection.fd, parts, part_count);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                Close(connection);
+                return;
+            }
+            while (sent > 0) {
+                PendingResponse& front = connection.responses.front();
+                const size_t left = front.data.size() - connection.sent_in_front;
+                if (static_cast<size_t>(sent) < left) {
+                    connection.sent_in_front += sent;
+                    break;
+                }
+                sent -= left;
+                connection.sent_in_front = 0;
+                connection.responses.pop_front();
+            }
+        }
+
+        const bool want_write = !connection.responses.empty() && connection.responses.front().ready;
+        if (want_write != connection.want_write) {
+            connection.want_write = want_write;
+            Watch(connection.fd, EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u), id, EPOLL_CTL_MOD);
+        }
+    }
+
+    // Соединение только помечается закрытым: удаляют его HandleConnection и DrainCompletions,
+    // когда на него больше нет ссылок и рабочие потоки вернули все ответы
+    void Close(Connection& connection) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection.fd, nullptr);
+        close(connection.fd);
+        connection.closed = true;
+    }
+
+    SearchServer& search_server_;
+    chrono::microseconds search_timeout_;
+    shared_mutex index_mutex_;
+    int listen_fd_;
+    int epoll_fd_;
+    int wakeup_fd_;
+    unordered_map<uint64_t, unique_ptr<Connection>> connections_;
+    uint64_t next_connection_id_ = 2;
+    mutex completions_mutex_;
+    vector<Completion> completions_;
+    WorkerPool workers_;
+};
+
+atomic_bool stop_requested = false;
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: "s << argv[0] << " ADDRESS [--workers N] [--stop-words WORDS] [--corpus FILE] [--memory-budget BYTES] [--deadline-us MICROSECONDS]"s << endl;
+        return 1;
+    }
+    const string address = argv[1];
+    size_t worker_count = max(1u, thread::hardware_concurrency());
+    string stop_words;
+    string corpus;
+    size_t memory_budget = 0;
+    chrono::microseconds search_timeout{ 0 };
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        if (option == "--workers"s) {
+            worker_count = stoul(argv[i + 1]);
+        }
+        else if (option == "--stop-words"s) {
+            stop_words = argv[i + 1];
+        }
+        else if (option == "--corpus"s) {
+            corpus = argv[i + 1];
+        }
+        else if (option == "--memory-budget"s) {
+            memory_budget = stoull(argv[i + 1]);
+        }
+        else if (option == "--deadline-us"s) {
+            search_timeout = chrono::microseconds(stoll(argv[i + 1]));
+        }
+    }
+
+    try {
+        SearchServer search_server(stop_words);
+        search_server.SetMemoryBudget(memory_budget);
+        if (!corpus.empty()) {
+            const CorpusLoadResult loaded = LoadCorpusFile(search_server, corpus);
+            for (const CorpusError& error : loaded.errors) {
+                cerr << corpus << ":"s << error.line << ": "s << error.message << endl;
+            }
+            const MemoryStats memory = search_server.GetMemoryStats();
+            cerr << "Loaded "s << search_server.GetDocumentCount() << " documents, "s
+                << memory.bytes / 1024 << " KiB in index, "s << memory.reserved_bytes / 1024 << " KiB reserved"s << endl;
+        }
+
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, [](int) {
+            stop_requested = true;
+            });
+        signal(SIGTERM, [](int) {
+            stop_requested = true;
+            });
+
+        const int listen_fd = OpenListeningSocket(address);
+        cerr << "Listening on "s << address << " with "s << worker_count << " workers"s << endl;
+        {
+            SearchDaemon daemon(search_server, listen_fd, worker_count, search_timeout);
+            daemon.Run(stop_requested);
+        }
+        const SearchStats stats = search_server.GetSearchStats();
+        cerr << "Partial results: "s << stats.partial_results << ", deadline hits: "s << stats.deadline_hits << endl;
+        close(listen_fd);
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
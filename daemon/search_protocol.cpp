@@ -0,0 +1,335 @@
+#include "search_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+void Append(vector<char>& out, T value) {
+    const size_t size = out.size();
+    out.resize(size + sizeof(T));
+    memcpy(out.data() + size, &value, sizeof(T));
+}
+
+void Append(vector<char>& out, string_view bytes) {
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// Резервирует место под длину кадра, которая дописывается в FinishFrame
+size_t StartFrame(vector<char>& out) {
+    const size_t start = out.size();
+    Append<uint32_t>(out, 0);
+    return start;
+}
+
+void FinishFrame(vector<char>& out, size_t start) {
+    const uint32_t size = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+    memcpy(out.data() + start, &size, sizeof(size));
+}
+
+class Reader {
+public:
+    explicit Reader(span<const char> data) : data_(data) {}
+
+    template <typename T>
+    T Read() {
+        Require(sizeof(T));
+        T value;
+        memcpy(&value, data_.data(), sizeof(T));
+        data_ = data_.subspan(sizeof(T));
+        return value;
+    }
+
+    string_view ReadBytes(size_t size) {
+        Require(size);
+        const string_view bytes(data_.data(), size);
+        data_ = data_.subspan(size);
+        return bytes;
+    }
+
+    string_view Rest() {
+        return ReadBytes(data_.size());
+    }
+
+private:
+    void Require(size_t size) const {
+        if (data_.size() < size) {
+            throw invalid_argument("Truncated frame"s);
+        }
+    }
+
+    span<const char> data_;
+};
+
+DocumentStatus ReadStatus(Reader& reader) {
+    const uint8_t status = reader.Read<uint8_t>();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw invalid_argument("Invalid document status"s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+// Возвращает тело кадра или пустой span, если кадр ещё не получен целиком
+span<const char> FrameBody(span<const char> buffer) {
+    uint32_t size;
+    if (buffer.size() < sizeof(size)) {
+        return {};
+    }
+    memcpy(&size, buffer.data(), sizeof(size));
+    if (size > MAX_FRAME_SIZE) {
+        throw invalid_argument("Frame is too large"s);
+    }
+    if (buffer.size() < sizeof(size) + size) {
+        return {};
+    }
+    return buffer.subspan(sizeof(size), size);
+}
+
+void StartRequest(vector<char>& out, uint32_t request_id, RequestType type) {
+    Append(out, request_id);
+    Append(out, static_cast<uint8_t>(type));
+}
+
+void StartResponse(vector<char>& out, uint32_t request_id, ResponseStatus status) {
+    Append(out, request_id);
+    Append(out, static_cast<uint8_t>(status));
+}
+
+}
+
+size_t ParseRequest(span<const char> buffer, Request& request) {
+    const span<const char> body = FrameBody(buffer);
+    if (body.data() == nullptr) {
+        return 0;
+    }
+    Reader reader(body);
+    request.request_id = reader.Read<uint32_t>();
+    request.type = static_cast<RequestType>(reader.Read<uint8_t>());
+    request.ratings.clear();
+    request.text = {};
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        request.status = ReadStatus(reader);
+        request.text = reader.Rest();
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        request.document_id = reader.Read<int32_t>();
+        request.text = reader.Rest();
+        break;
+    case RequestType::ADD_DOCUMENT: {
+        request.document_id = reader.Read<int32_t>();
+        request.status = ReadStatus(reader);
+        const uint32_t rating_count = reader.Read<uint32_t>();
+        if (rating_count > body.size() / sizeof(int32_t)) {
+            throw invalid_argument("Invalid rating count"s);
+        }
+        request.ratings.reserve(rating_count);
+        for (uint32_t i = 0; i < rating_count; ++i) {
+            request.ratings.push_back(reader.Read<int32_t>());
+        }
+        request.text = reader.Rest();
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT:
+        request.document_id = reader.Read<int32_t>();
+        break;
+    default:
+        throw invalid_argument("Unknown request type"s);
+    }
+    return sizeof(uint32_t) + body.size();
+}
+
+size_t ParseResponse(span<const char> buffer, Response& response) {
+    const span<const char> body = FrameBody(buffer);
+    if (body.data() == nullptr) {
+        return 0;
+    }
+    Reader reader(body);
+    response.request_id = reader.Read<uint32_t>();
+    response.status = static_cast<ResponseStatus>(reader.Read<uint8_t>());
+    const string_view payload = reader.Rest();
+    response.payload = { payload.data(), payload.size() };
+    return sizeof(uint32_t) + body.size();
+}
+
+void WriteFindTopDocumentsRequest(vector<char>& out, uint32_t request_id, DocumentStatus status, string_view query) {
+    const size_t frame = StartFrame(out);
+    StartRequest(out, request_id, RequestType::FIND_TOP_DOCUMENTS);
+    Append(out, static_cast<uint8_t>(status));
+    Append(out, query);
+    FinishFrame(out, frame);
+}
+
+void WriteMatchDocumentRequest(vector<char>& out, uint32_t request_id, int document_id, string_view query) {
+    const size_t frame = StartFrame(out);
+    StartRequest(out, request_id, RequestType::MATCH_DOCUMENT);
+    Append<int32_t>(out, document_id);
+    Append(out, query);
+    FinishFrame(out, frame);
+}
+
+void WriteAddDocumentRequest(vector<char>& out, uint32_t request_id, int document_id, DocumentStatus status,
+    const vector<int>& ratings, string_view text) {
+    const size_t frame = StartFrame(out);
+    StartRequest(out, request_id, RequestType::ADD_DOCUMENT);
+    Append<int32_t>(out, document_id);
+    Append(out, static_cast<uint8_t>(status));
+    Append(out, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        Append<int32_t>(out, rating);
+    }
+    Append(out, text);
+    FinishFrame(out, frame);
+}
+
+void WriteRemoveDocumentRequest(vector<char>& out, uint32_t request_id, int document_id) {
+    const size_t frame = StartFrame(out);
+    StartRequest(out, request_id, RequestType::REMOVE_DOCUMENT);
+    Append<int32_t>(out, document_id);
+    FinishFrame(out, frame);
+}
+
+void WriteDocumentsResponse(vector<char>& out, uint32_t request_id, const vector<Document>& documents, bool is_partial) {
+    const size_t frame = StartFrame(out);
+    StartResponse(out, request_id, is_partial ? ResponseStatus::PARTIAL : ResponseStatus::OK);
+    Append(out, static_cast<uint32_t>(documents.size()));
+    for (const Document& document : documents) {
+        Append<int32_t>(out, document.id);
+        Append(out, document.relevance);
+        Append<int32_t>(out, document.rating);
+    }
+    FinishFrame(out, frame);
+}
+
+void WriteMatchResponse(vector<char>& out, uint32_t request_id, span<const string_view> words, DocumentStatus status) {
+    const size_t frame = StartFrame(out);
+    StartResponse(out, request_id, ResponseStatus::OK);
+    Append(out, static_cast<uint8_t>(status));
+    Append(out, static_cast<uint32_t>(words.size()));
+    for (const string_view word : words) {
+        Append(out, static_cast<uint32_t>(word.size()));
+        Append(out, word);
+    }
+    FinishFrame(out, frame);
+}
+
+void WriteEmptyResponse(vector<char>& out, uint32_t request_id) {
+    const size_t frame = StartFrame(out);
+    StartResponse(out, request_id, ResponseStatus::OK);
+    FinishFrame(out, frame);
+}
+
+void WriteErrorResponse(vector<char>& out, uint32_t request_id, string_view message) {
+    const size_t frame = StartFrame(out);
+    StartResponse(out, request_id, ResponseStatus::ERROR);
+    Append(out, message);
+    FinishFrame(out, frame);
+}
+
+vector<Document> ReadDocuments(span<const char> payload) {
+    Reader reader(payload);
+    const uint32_t count = reader.Read<uint32_t>();
+    vector<Document> documents;
+    documents.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const int id = reader.Read<int32_t>();
+        const double relevance = reader.Read<double>();
+        const int rating = reader.Read<int32_t>();
+        documents.emplace_back(id, relevance, rating);
+    }
+    return documents;
+}
+
+namespace {
+
+struct SocketAddress {
+    sockaddr_storage storage{};
+    socklen_t size = 0;
+    bool is_unix = false;
+};
+
+SocketAddress ResolveAddress(const string& address) {
+    SocketAddress result;
+    if (address.rfind("unix:"s, 0) == 0) {
+        const string path = address.substr(5);
+        sockaddr_un unix_address{};
+        if (path.empty() || path.size() >= sizeof(unix_address.sun_path)) {
+            throw invalid_argument("Invalid unix socket path "s + path);
+        }
+        unix_address.sun_family = AF_UNIX;
+        memcpy(unix_address.sun_path, path.data(), path.size());
+        memcpy(&result.storage, &unix_address, sizeof(unix_address));
+        result.size = sizeof(unix_address);
+        result.is_unix = true;
+        return result;
+    }
+
+    const size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("Address must be unix:PATH or HOST:PORT"s);
+    }
+    sockaddr_in inet_address{};
+    inet_address.sin_family = AF_INET;
+    inet_address.sin_port = htons(static_cast<uint16_t>(stoi(address.substr(colon + 1))));
+    const string host = colon == 0 ? "0.0.0.0"s : address.substr(0, colon);
+    if (inet_pton(AF_INET, host.c_str(), &inet_address.sin_addr) != 1) {
+        throw invalid_argument("Invalid IPv4 address "s + host);
+    }
+    memcpy(&result.storage, &inet_address, sizeof(inet_address));
+    result.size = sizeof(inet_address);
+    return result;
+}
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+}
+
+int OpenListeningSocket(const string& address) {
+    const SocketAddress resolved = ResolveAddress(address);
+    const int fd = socket(resolved.storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (resolved.is_unix) {
+        unlink(reinterpret_cast<const sockaddr_un*>(&resolved.storage)->sun_path);
+    }
+    else {
+        const int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&resolved.storage), resolved.size) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        ThrowSystemError("bind "s + address);
+    }
+    return fd;
+}
+
+int ConnectToServer(const string& address) {
+    const SocketAddress resolved = ResolveAddress(address);
+    const int fd = socket(resolved.storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&resolved.storage), resolved.size) < 0) {
+        close(fd);
+        ThrowSystemError("connect "s + address);
+    }
+    if (!resolved.is_unix) {
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    return fd;
+}
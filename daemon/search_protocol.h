@@ -0,0 +1,74 @@
+#pragma once
+#include "../document.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Двоичный протокол поискового сервера. Кадр: [u32 длина тела][тело], числа в порядке байт хоста
+// (little-endian на x86/ARM). Тело запроса: [u32 request_id][u8 тип][поля типа].
+// Тело ответа: [u32 request_id][u8 статус][данные]. Ответы на одном соединении идут в порядке запросов,
+// поэтому клиент может отправлять запросы, не дожидаясь ответов
+//
+// FIND_TOP_DOCUMENTS: [u8 статус документа][запрос]       -> [u32 n]{[i32 id][f64 relevance][i32 rating]} x n
+// MATCH_DOCUMENT:     [i32 id][запрос]                    -> [u8 статус документа][u32 n]{[u32 длина][слово]} x n
+// ADD_DOCUMENT:       [i32 id][u8 статус][u32 n][i32 рейтинг x n][текст] -> пусто
+// REMOVE_DOCUMENT:    [i32 id]                            -> пусто
+// При ошибке статус ответа ERROR, данные - текст ошибки
+
+const std::uint32_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+enum class RequestType : std::uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+// PARTIAL - ответ на FIND_TOP_DOCUMENTS, поиск остановлен по сроку; данные как у OK
+enum class ResponseStatus : std::uint8_t {
+    OK = 0,
+    ERROR = 1,
+    PARTIAL = 2,
+};
+
+// Поле text ссылается на буфер, из которого разобран запрос
+struct Request {
+    std::uint32_t request_id = 0;
+    RequestType type = RequestType::FIND_TOP_DOCUMENTS;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct Response {
+    std::uint32_t request_id = 0;
+    ResponseStatus status = ResponseStatus::OK;
+    std::span<const char> payload;
+};
+
+// Возвращают размер разобранного кадра или 0, если кадр ещё не получен целиком.
+// Повреждённый кадр приводит к исключению std::invalid_argument
+size_t ParseRequest(std::span<const char> buffer, Request& request);
+size_t ParseResponse(std::span<const char> buffer, Response& response);
+
+void WriteFindTopDocumentsRequest(std::vector<char>& out, std::uint32_t request_id, DocumentStatus status, std::string_view query);
+void WriteMatchDocumentRequest(std::vector<char>& out, std::uint32_t request_id, int document_id, std::string_view query);
+void WriteAddDocumentRequest(std::vector<char>& out, std::uint32_t request_id, int document_id, DocumentStatus status,
+    const std::vector<int>& ratings, std::string_view text);
+void WriteRemoveDocumentRequest(std::vector<char>& out, std::uint32_t request_id, int document_id);
+
+// Ответы пишутся прямо в выходной буфер соединения, без промежуточных объектов
+void WriteDocumentsResponse(std::vector<char>& out, std::uint32_t request_id, const std::vector<Document>& documents, bool is_partial = false);
+void WriteMatchResponse(std::vector<char>& out, std::uint32_t request_id, std::span<const std::string_view> words, DocumentStatus status);
+void WriteEmptyResponse(std::vector<char>& out, std::uint32_t request_id);
+void WriteErrorResponse(std::vector<char>& out, std::uint32_t request_id, std::string_view message);
+
+std::vector<Document> ReadDocuments(std::span<const char> payload);
+
+// Адрес сервера: "unix:/path/to/socket" или "host:port" (только IPv4)
+int OpenListeningSocket(const std::string& address);
+int ConnectToServer(const std::string& address);
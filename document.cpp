@@ -13,6 +13,14 @@ Document::Document(int id, double relevance, int rating)
     , rating(rating) {
 }
 
+size_t MatchedDocuments::size() const {
+    return document_ids.size();
+}
+
+span<const string_view> MatchedDocuments::GetWords(size_t index) const {
+    return { words.data() + word_offsets[index], words.data() + word_offsets[index + 1] };
+}
+
 void PrintDocument(const Document& document) {
     cout << "{ "s
         << "document_id = "s << document.id << ", "s
@@ -20,7 +28,20 @@ void PrintDocument(const Document& document) {
         << "rating = "s << document.rating << " }"s << endl;
 }
 
-void PrintMatchDocumentResult(int document_id, const vector<string_view>& words, DocumentStatus status) {
+void PrintQueryPlan(const QueryPlan& plan) {
+    static const char* const ACTION_NAMES[] = { "EXCLUDE", "REQUIRE", "SCORE", "SKIP" };
+    for (const QueryPlanStep& step : plan.steps) {
+        cout << ACTION_NAMES[static_cast<int>(step.action)] << ' ' << step.word
+            << " postings = "s << step.postings << ", cost = "s << step.cost << endl;
+    }
+    cout << "cost = "s << plan.cost << ", max candidates = "s << plan.max_candidates;
+    if (plan.is_empty) {
+        cout << ", empty"s;
+    }
+    cout << endl;
+}
+
+void PrintMatchDocumentResult(int document_id, span<const string_view> words, DocumentStatus status) {
     cout << "{ "s
         << "document_id = "s << document_id << ", "s
         << "status = "s << static_cast<int>(status) << ", "s
@@ -38,6 +59,9 @@ void AddDocument(SearchServer& search_server, int document_id, const string_view
     catch (const invalid_argument& e) {
         cout << "Ошибка добавления документа "s << document_id << ": "s << e.what() << endl;
     }
+    catch (const length_error& e) {
+        cout << "Ошибка добавления документа "s << document_id << ": "s << e.what() << endl;
+    }
 }
 
 void FindTopDocuments(const SearchServer& search_server, const string_view raw_query) {
@@ -55,9 +79,9 @@ void FindTopDocuments(const SearchServer& search_server, const string_view raw_q
 void MatchDocuments(const SearchServer& search_server, const string_view query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.SearchServer::MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const MatchedDocuments matches = search_server.SearchServer::MatchDocuments(query, { search_server.begin(), search_server.end() });
+        for (size_t i = 0; i < matches.size(); ++i) {
+            PrintMatchDocumentResult(matches.document_ids[i], matches.GetWords(i), matches.statuses[i]);
         }
     }
     catch (const invalid_argument& e) {
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <string>
 #include <vector>
+#include <set>
 #include <string_view>
+#include <span>
 
 struct Document {
     Document() = default;
@@ -21,10 +25,127 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Непрозрачная позиция в выдаче: следующая страница начинается с документов, ранжированных ниже
+// последнего документа предыдущей. Курсор по умолчанию указывает на начало выдачи
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+private:
+    friend class SearchServer;
+
+    explicit SearchCursor(const Document& last)
+        : is_start_(false)
+        , last_(last) {
+    }
+
+    bool is_start_ = true;
+    Document last_;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    SearchCursor next;
+    bool is_last = true;
+};
+
+// Результат сопоставления запроса с группой документов одной плоской структурой:
+// слова i-го документа лежат в words[word_offsets[i], word_offsets[i + 1])
+struct MatchedDocuments {
+    std::vector<int> document_ids;
+    std::vector<DocumentStatus> statuses;
+    std::vector<size_t> word_offsets;
+    std::vector<std::string_view> words;
+
+    size_t size() const;
+    std::span<const std::string_view> GetWords(size_t index) const;
+};
+
+// ANY - документ подходит, если содержит хотя бы одно плюс-слово, ALL - если содержит все.
+// В режиме ANY отдельные слова можно сделать обязательными: "+кот пушистый"
+enum class QueryMode {
+    ANY,
+    ALL,
+};
+
+// Ограничения одного запроса: срок и число постингов, которые разрешено обработать (0 - без ограничения)
+struct SearchOptions {
+    QueryMode mode = QueryMode::ANY;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_postings = 0;
+};
+
+// is_partial - подсчёт релевантности остановлен по сроку или бюджету, документы - лучшие из найденных к этому моменту
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+struct SearchStats {
+    size_t partial_results = 0;
+    size_t deadline_hits = 0;
+    size_t budget_hits = 0;
+};
+
+enum class QueryPlanAction {
+    EXCLUDE,
+    REQUIRE,
+    SCORE,
+    SKIP,
+};
+
+// Шаг плана запроса. postings - длина списка документов слова, cost - оценка числа постингов,
+// которые придётся обойти: при пересечении списков шаг ограничен числом кандидатов.
+// SKIP - слова нет в индексе, оно ничего не стоит
+struct QueryPlanStep {
+    std::string word;
+    QueryPlanAction action = QueryPlanAction::SKIP;
+    size_t postings = 0;
+    size_t cost = 0;
+};
+
+// План в порядке выполнения: сначала исключения по минус-словам, затем пересечение списков
+// обязательных слов и подсчёт релевантности, от коротких списков к длинным.
+// Если is_empty, поиск завершается без обхода индекса
+struct QueryPlan {
+    std::vector<QueryPlanStep> steps;
+    size_t cost = 0;
+    size_t max_candidates = 0;
+    bool is_empty = true;
+};
+
+// Встроенные предикаты: SearchServer распознаёт их при компиляции и фильтрует документы
+// битовыми масками до подсчёта релевантности. Произвольные функции вызываются для каждого документа
+struct DocumentStatusIs {
+    DocumentStatus status;
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+        return document_status == status;
+    }
+};
+
+struct DocumentRatingBetween {
+    int min_rating;
+    int max_rating;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return rating >= min_rating && rating <= max_rating;
+    }
+};
+
+struct DocumentIdIn {
+    std::set<int> ids;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return ids.count(document_id) > 0;
+    }
+};
+
 class SearchServer;
 
 void PrintDocument(const Document& document);
-void PrintMatchDocumentResult(int document_id, const std::vector<std::string_view>& words, DocumentStatus status);
+void PrintQueryPlan(const QueryPlan& plan);
+void PrintMatchDocumentResult(int document_id, std::span<const std::string_view> words, DocumentStatus status);
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 void FindTopDocuments(const SearchServer& search_server, const std::string_view raw_query);
 void MatchDocuments(const SearchServer& search_server, const std::string_view query);
\ No newline at end of file
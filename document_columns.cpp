@@ -0,0 +1,144 @@
+#include "document_columns.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+Bitmap::Bitmap(pmr::memory_resource* resource)
+    : words_(resource) {
+}
+
+Bitmap::Bitmap(size_t size, pmr::memory_resource* resource)
+    : words_((size + 63) / 64, 0, resource)
+    , size_(size) {
+}
+
+void Bitmap::Resize(size_t size) {
+    words_.resize((size + 63) / 64, 0);
+    size_ = size;
+}
+
+void Bitmap::Set(size_t index) {
+    words_[index / 64] |= uint64_t{ 1 } << (index % 64);
+}
+
+void Bitmap::Reset(size_t index) {
+    words_[index / 64] &= ~(uint64_t{ 1 } << (index % 64));
+}
+
+size_t Bitmap::Size() const {
+    return size_;
+}
+
+size_t Bitmap::WordCount() const {
+    return words_.size();
+}
+
+uint64_t Bitmap::GetWord(size_t word_index) const {
+    return words_[word_index];
+}
+
+void Bitmap::SetWord(size_t word_index, uint64_t word) {
+    words_[word_index] = word;
+}
+
+Bitmap& Bitmap::operator&=(const Bitmap& other) {
+    const size_t common = min(words_.size(), other.words_.size());
+    for (size_t i = 0; i < common; ++i) {
+        words_[i] &= other.words_[i];
+    }
+    fill(words_.begin() + common, words_.end(), 0);
+    return *this;
+}
+
+DocumentColumns::DocumentColumns(pmr::memory_resource* resource)
+    : ids_(resource)
+    , ratings_(resource)
+    , statuses_(resource)
+    , word_counts_(resource)
+    , status_bitmaps_{ Bitmap(resource), Bitmap(resource), Bitmap(resource), Bitmap(resource) }
+    , alive_(resource) {
+}
+
+int DocumentColumns::Add(int document_id, DocumentStatus status, int rating, uint32_t word_count) {
+    const int slot = static_cast<int>(ids_.size());
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+    word_counts_.push_back(word_count);
+    for (Bitmap& bitmap : status_bitmaps_) {
+        bitmap.Resize(ids_.size());
+    }
+    alive_.Resize(ids_.size());
+    status_bitmaps_[static_cast<int>(status)].Set(slot);
+    alive_.Set(slot);
+    ++live_count_;
+    return slot;
+}
+
+void DocumentColumns::Remove(int slot) {
+    status_bitmaps_[static_cast<int>(statuses_[slot])].Reset(slot);
+    alive_.Reset(slot);
+    --live_count_;
+}
+
+vector<int> DocumentColumns::Compact() {
+    vector<int> new_slots(ids_.size(), -1);
+    int next_slot = 0;
+    for (size_t slot = 0; slot < ids_.size(); ++slot) {
+        if (!alive_.Test(slot)) {
+            continue;
+        }
+        new_slots[slot] = next_slot;
+        ids_[next_slot] = ids_[slot];
+        ratings_[next_slot] = ratings_[slot];
+        statuses_[next_slot] = statuses_[slot];
+        word_counts_[next_slot] = word_counts_[slot];
+        ++next_slot;
+    }
+    ids_.resize(next_slot);
+    ratings_.resize(next_slot);
+    statuses_.resize(next_slot);
+    word_counts_.resize(next_slot);
+
+    for (Bitmap* bitmap : { &status_bitmaps_[0], &status_bitmaps_[1], &status_bitmaps_[2], &status_bitmaps_[3], &alive_ }) {
+        bitmap->Resize(0);
+        bitmap->Resize(next_slot);
+    }
+    for (int slot = 0; slot < next_slot; ++slot) {
+        status_bitmaps_[static_cast<int>(statuses_[slot])].Set(slot);
+        alive_.Set(slot);
+    }
+    return new_slots;
+}
+
+size_t DocumentColumns::GetSlotCount() const {
+    return ids_.size();
+}
+
+size_t DocumentColumns::GetLiveCount() const {
+    return live_count_;
+}
+
+const Bitmap& DocumentColumns::GetStatusBitmap(DocumentStatus status) const {
+    return status_bitmaps_[static_cast<int>(status)];
+}
+
+Bitmap DocumentColumns::SelectRatings(int min_rating, int max_rating) const {
+    Bitmap result(ratings_.size());
+    const int* ratings = ratings_.data();
+    for (size_t word_index = 0; word_index < result.WordCount(); ++word_index) {
+        const size_t begin = word_index * 64;
+        const size_t count = min<size_t>(64, ratings_.size() - begin);
+        // Сравнения без ветвлений, цикл векторизуется компилятором
+        uint64_t word = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const int rating = ratings[begin + i];
+            word |= static_cast<uint64_t>(rating >= min_rating && rating <= max_rating) << i;
+        }
+        result.SetWord(word_index, word & alive_.GetWord(word_index));
+    }
+    return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "document.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+
+const int DOCUMENT_STATUS_COUNT = 4;
+
+class Bitmap {
+public:
+    explicit Bitmap(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit Bitmap(size_t size, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void Resize(size_t size);
+    void Set(size_t index);
+    void Reset(size_t index);
+
+    bool Test(size_t index) const {
+        return index < size_ && (words_[index / 64] >> (index % 64)) & 1;
+    }
+
+    size_t Size() const;
+    size_t WordCount() const;
+    std::uint64_t GetWord(size_t word_index) const;
+    void SetWord(size_t word_index, std::uint64_t word);
+    Bitmap& operator&=(const Bitmap& other);
+
+private:
+    std::pmr::vector<std::uint64_t> words_;
+    size_t size_ = 0;
+};
+
+// Атрибуты документов по столбцам. Документ адресуется слотом: слоты выдаются подряд,
+// у удалённого документа не выставлен ни один бит статуса
+class DocumentColumns {
+public:
+    explicit DocumentColumns(std::pmr::memory_resource* resource);
+
+    int Add(int document_id, DocumentStatus status, int rating, std::uint32_t word_count);
+    void Remove(int slot);
+    // Сдвигает живые слоты подряд с сохранением порядка. Возвращает новый номер
+    // для каждого старого слота, -1 для удалённых
+    std::vector<int> Compact();
+
+    int GetId(int slot) const {
+        return ids_[slot];
+    }
+
+    DocumentStatus GetStatus(int slot) const {
+        return statuses_[slot];
+    }
+
+    int GetRating(int slot) const {
+        return ratings_[slot];
+    }
+
+    std::uint32_t GetWordCount(int slot) const {
+        return word_counts_[slot];
+    }
+
+    bool IsAlive(int slot) const {
+        return alive_.Test(slot);
+    }
+
+    const Bitmap& GetAliveBitmap() const {
+        return alive_;
+    }
+
+    const std::uint32_t* WordCounts() const {
+        return word_counts_.data();
+    }
+
+    size_t GetSlotCount() const;
+    size_t GetLiveCount() const;
+    const Bitmap& GetStatusBitmap(DocumentStatus status) const;
+    Bitmap SelectRatings(int min_rating, int max_rating) const;
+
+private:
+    std::pmr::vector<int> ids_;
+    std::pmr::vector<int> ratings_;
+    std::pmr::vector<DocumentStatus> statuses_;
+    std::pmr::vector<std::uint32_t> word_counts_;
+    std::array<Bitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+    Bitmap alive_;
+    size_t live_count_ = 0;
+};
+
+// Фильтр документов по битовой маске слотов, собранной до подсчёта релевантности
+class DocumentFilter {
+public:
+    explicit DocumentFilter(const Bitmap& bitmap) : bitmap_(&bitmap) {}
+    explicit DocumentFilter(Bitmap&& bitmap) : owned_(std::move(bitmap)), bitmap_(&owned_) {}
+    DocumentFilter(const DocumentFilter&) = delete;
+    DocumentFilter& operator=(const DocumentFilter&) = delete;
+
+    bool operator()(int slot) const {
+        return bitmap_->Test(slot);
+    }
+
+private:
+    Bitmap owned_;
+    const Bitmap* bitmap_;
+};
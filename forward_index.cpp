@@ -0,0 +1,59 @@
+#include "forward_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+ForwardIndex::ForwardIndex(pmr::memory_resource* resource)
+    : entries_(resource)
+    , ranges_(resource) {
+}
+
+int ForwardIndex::Add(vector<int>& term_ids) {
+    sort(term_ids.begin(), term_ids.end());
+
+    const size_t begin = entries_.size();
+    for (const int term_id : term_ids) {
+        if (entries_.size() > begin && entries_.back().term_id == term_id) {
+            ++entries_.back().count;
+        }
+        else {
+            entries_.push_back({ term_id, 1 });
+        }
+    }
+    ranges_.push_back({ begin, static_cast<uint32_t>(entries_.size() - begin) });
+    return static_cast<int>(ranges_.size() - 1);
+}
+
+void ForwardIndex::Remove(int slot) {
+    garbage_ += ranges_[slot].size;
+    ranges_[slot] = { 0, 0 };
+    if (garbage_ > entries_.size() / 2) {
+        Compact();
+    }
+}
+
+void ForwardIndex::Renumber(const vector<int>& new_slots) {
+    size_t live_count = 0;
+    for (size_t slot = 0; slot < ranges_.size(); ++slot) {
+        if (new_slots[slot] >= 0) {
+            ranges_[new_slots[slot]] = ranges_[slot];
+            ++live_count;
+        }
+    }
+    ranges_.resize(live_count);
+}
+
+void ForwardIndex::Compact() {
+    pmr::vector<Entry> entries(entries_.get_allocator());
+    entries.reserve(entries_.size() - garbage_);
+    for (Range& range : ranges_) {
+        const auto first = entries_.begin() + range.begin;
+        range.begin = entries.size();
+        entries.insert(entries.end(), first, first + range.size);
+    }
+    entries_.swap(entries);
+    garbage_ = 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <memory_resource>
+
+// Прямой индекс: для каждого слота документа - непрерывный отсортированный по номеру терма
+// участок общего массива. Вместо частоты хранится число вхождений терма, частота
+// восстанавливается точно как count / word_count, длина документа хранится в DocumentColumns
+class ForwardIndex {
+public:
+    struct Entry {
+        int term_id;
+        std::uint32_t count;
+    };
+
+    explicit ForwardIndex(std::pmr::memory_resource* resource);
+
+    // term_ids - номера термов документа с повторами, порядок не важен
+    int Add(std::vector<int>& term_ids);
+    void Remove(int slot);
+    // Переносит участки на новые номера слотов, new_slots[slot] < 0 - документ удалён
+    void Renumber(const std::vector<int>& new_slots);
+
+    std::span<const Entry> GetEntries(int slot) const {
+        const Range& range = ranges_[slot];
+        return { entries_.data() + range.begin, range.size };
+    }
+
+    // Записи живых документов, без мусора от удалённых
+    size_t GetEntryCount() const {
+        return entries_.size() - garbage_;
+    }
+
+private:
+    struct Range {
+        size_t begin;
+        std::uint32_t size;
+    };
+
+    std::pmr::vector<Entry> entries_;
+    std::pmr::vector<Range> ranges_;
+    size_t garbage_ = 0;
+
+    void Compact();
+};
+
+// Представление частот слов одного документа: обход выдаёт пары (слово, частота) как у
+// std::map<std::string_view, double>, но в порядке номеров термов (порядке первого появления слова
+// в индексе), а не по алфавиту. Поиска по слову (find, count, at) нет.
+// Действительно до следующего изменения индекса
+class WordFrequenciesView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const ForwardIndex::Entry* entry, const std::string_view* words, double inv_word_count)
+            : entry_(entry)
+            , words_(words)
+            , inv_word_count_(inv_word_count) {
+        }
+
+        value_type operator*() const {
+            return { words_[entry_->term_id], entry_->count * inv_word_count_ };
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++entry_;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+    private:
+        const ForwardIndex::Entry* entry_ = nullptr;
+        const std::string_view* words_ = nullptr;
+        double inv_word_count_ = 0.0;
+    };
+
+    WordFrequenciesView() = default;
+    WordFrequenciesView(std::span<const ForwardIndex::Entry> entries, std::span<const std::string_view> words, std::uint32_t word_count)
+        : entries_(entries)
+        , words_(words)
+        , inv_word_count_(1.0 / word_count) {
+    }
+
+    Iterator begin() const {
+        return { entries_.data(), words_.data(), inv_word_count_ };
+    }
+
+    Iterator end() const {
+        return { entries_.data() + entries_.size(), words_.data(), inv_word_count_ };
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    bool empty() const {
+        return entries_.empty();
+    }
+
+private:
+    std::span<const ForwardIndex::Entry> entries_;
+    std::span<const std::string_view> words_;
+    double inv_word_count_ = 0.0;
+};
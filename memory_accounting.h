@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// Ресурс-обёртка, который считает байты и блоки, взятые у вышестоящего ресурса.
+// Счётчики атомарные: их можно читать из другого потока, пока индекс изменяется
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream)
+        : upstream_(upstream) {
+    }
+
+    size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+    size_t GetPeakBytes() const {
+        return peak_bytes_.load(std::memory_order_relaxed);
+    }
+
+    size_t GetBlocks() const {
+        return blocks_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* pointer = upstream_->allocate(bytes, alignment);
+        const size_t current = bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        blocks_.fetch_add(1, std::memory_order_relaxed);
+        size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+        while (peak < current && !peak_bytes_.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+        return pointer;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        upstream_->deallocate(pointer, bytes, alignment);
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        blocks_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* upstream_;
+    std::atomic_size_t bytes_ = 0;
+    std::atomic_size_t peak_bytes_ = 0;
+    std::atomic_size_t blocks_ = 0;
+};
+
+struct StructureMemory {
+    size_t bytes = 0;
+    size_t blocks = 0;
+    size_t entries = 0;
+};
+
+// bytes - сумма выделений по структурам. reserved_bytes - сколько собственный пул сервера
+// взял у системы (0, если сервер работает в переданном ему ресурсе)
+struct MemoryStats {
+    StructureMemory stop_words;
+    StructureMemory dictionary;
+    StructureMemory postings;
+    StructureMemory forward_index;
+    StructureMemory documents;
+    StructureMemory columns;
+    size_t bytes = 0;
+    size_t peak_bytes = 0;
+    size_t reserved_bytes = 0;
+    size_t budget_bytes = 0;
+};
+
+const size_t POSTING_HISTOGRAM_SIZE = 32;
+
+// histogram[k] - число термов, у которых длина списка документов в [2^k, 2^(k+1)).
+// Термы без документов (все их документы удалены) считаются в empty_terms
+struct PostingStats {
+    size_t term_count = 0;
+    size_t empty_terms = 0;
+    size_t posting_count = 0;
+    size_t max_postings = 0;
+    double average_postings = 0.0;
+    std::array<size_t, POSTING_HISTOGRAM_SIZE> histogram{};
+};
@@ -1,6 +1,8 @@
 #pragma once
+#include "document.h"
 
 #include <vector>
+#include <utility>
 
 template <typename Iterator>
 class IteratorRange {
@@ -61,4 +63,62 @@ private:
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+
+// Постраничный обход выдачи, которая не хранится целиком: очередная страница
+// запрашивается через fetch(cursor) только при переходе к ней
+template <typename Fetch>
+class LazyPaginator {
+public:
+    class Iterator {
+    public:
+        Iterator() = default;
+
+        explicit Iterator(const Fetch* fetch) : fetch_(fetch) {
+            Load(SearchCursor());
+        }
+
+        IteratorRange<std::vector<Document>::const_iterator> operator*() const {
+            return { page_.documents.begin(), page_.documents.end() };
+        }
+
+        Iterator& operator++() {
+            if (page_.is_last) {
+                fetch_ = nullptr;
+            }
+            else {
+                Load(page_.next);
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return fetch_ == other.fetch_;
+        }
+
+    private:
+        void Load(const SearchCursor& cursor) {
+            page_ = (*fetch_)(cursor);
+            if (page_.documents.empty()) {
+                fetch_ = nullptr;
+            }
+        }
+
+        const Fetch* fetch_ = nullptr;
+        SearchPage page_;
+    };
+
+    explicit LazyPaginator(Fetch fetch) : fetch_(std::move(fetch)) {
+    }
+
+    Iterator begin() const {
+        return Iterator(&fetch_);
+    }
+
+    Iterator end() const {
+        return {};
+    }
+
+private:
+    Fetch fetch_;
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+using namespace std;
+
+PostingList::PostingList(const allocator_type& allocator)
+    : slots_(allocator)
+    , term_freqs_(allocator) {
+}
+
+PostingList::PostingList(const PostingList& other, const allocator_type& allocator)
+    : slots_(other.slots_, allocator)
+    , term_freqs_(other.term_freqs_, allocator)
+    , removed_(other.removed_) {
+}
+
+PostingList::PostingList(PostingList&& other, const allocator_type& allocator)
+    : slots_(move(other.slots_), allocator)
+    , term_freqs_(move(other.term_freqs_), allocator)
+    , removed_(other.removed_) {
+}
+
+void PostingList::Add(int slot, double term_freq) {
+    slots_.push_back(slot);
+    term_freqs_.push_back(term_freq);
+}
+
+void PostingList::Remove(const Bitmap& alive) {
+    ++removed_;
+    if (removed_ <= slots_.size() / 2) {
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (alive.Test(slots_[i])) {
+            slots_[kept] = slots_[i];
+            term_freqs_[kept] = term_freqs_[i];
+            ++kept;
+        }
+    }
+    slots_.resize(kept);
+    term_freqs_.resize(kept);
+    removed_ = 0;
+}
+
+void PostingList::Renumber(const vector<int>& new_slots) {
+    size_t kept = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        const int new_slot = new_slots[slots_[i]];
+        if (new_slot >= 0) {
+            slots_[kept] = new_slot;
+            term_freqs_[kept] = term_freqs_[i];
+            ++kept;
+        }
+    }
+    slots_.resize(kept);
+    term_freqs_.resize(kept);
+    removed_ = 0;
+}
+
+size_t GallopTo(span<const int> slots, size_t from, int target) {
+    const size_t size = slots.size();
+    if (from + GALLOP_BLOCK_SIZE > size) {
+        return lower_bound(slots.begin() + from, slots.end(), target) - slots.begin();
+    }
+
+    size_t below = 0;
+    for (size_t i = 0; i < GALLOP_BLOCK_SIZE; ++i) {
+        below += slots[from + i] < target;
+    }
+    if (below < GALLOP_BLOCK_SIZE) {
+        return from + below;
+    }
+
+    from += GALLOP_BLOCK_SIZE;
+    size_t bound = from;
+    size_t step = GALLOP_BLOCK_SIZE;
+    while (bound < size && slots[bound] < target) {
+        from = bound + 1;
+        bound += step;
+        step *= 2;
+    }
+    return lower_bound(slots.begin() + from, slots.begin() + min(bound, size), target) - slots.begin();
+}
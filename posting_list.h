@@ -0,0 +1,56 @@
+#pragma once
+#include "document_columns.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <memory_resource>
+
+const size_t GALLOP_BLOCK_SIZE = 8;
+
+// Список вхождений терма по столбцам: слоты документов по возрастанию и частоты терма в них.
+// Вхождения удалённых документов остаются в списке, пока их не больше половины: обходящий список
+// пропускает их по маске живых слотов, число документов терма считается без них
+class PostingList {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit PostingList(const allocator_type& allocator = {});
+    PostingList(const PostingList& other, const allocator_type& allocator);
+    PostingList(PostingList&& other, const allocator_type& allocator);
+
+    // Слоты выдаются по возрастанию, поэтому новый документ всегда дописывается в конец
+    void Add(int slot, double term_freq);
+    // Один из документов списка удалён, его бит в alive уже сброшен
+    void Remove(const Bitmap& alive);
+    // Переводит слоты на новые номера, new_slots[slot] < 0 - документ удалён.
+    // Перенумерация сохраняет порядок слотов
+    void Renumber(const std::vector<int>& new_slots);
+
+    std::span<const int> Slots() const {
+        return slots_;
+    }
+
+    std::span<const double> TermFreqs() const {
+        return term_freqs_;
+    }
+
+    // Число вхождений вместе с удалёнными
+    size_t size() const {
+        return slots_.size();
+    }
+
+    // Число живых документов с термом
+    size_t GetDocumentCount() const {
+        return slots_.size() - removed_;
+    }
+
+private:
+    std::pmr::vector<int> slots_;
+    std::pmr::vector<double> term_freqs_;
+    size_t removed_ = 0;
+};
+
+// Позиция первого слота не меньше target в slots, начиная с from. Сначала целиком, без ветвлений,
+// сравнивается блок из GALLOP_BLOCK_SIZE слотов, дальше шаг удваивается и интервал делится пополам
+size_t GallopTo(std::span<const int> slots, size_t from, int target);
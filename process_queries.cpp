@@ -9,8 +9,9 @@ using namespace std;
 
 vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<string>& queries) {
 	vector<vector<Document>>array_top_documents(queries.size());
-	transform(execution::par, queries.begin(), queries.end(), array_top_documents.begin(), [&search_server](const string& str) {
-		return search_server.FindTopDocuments(execution::par, str);
+	// Запросы и термы внутри них делят один планировщик сервера, вложенный параллелизм не размножает потоки
+	search_server.GetTaskScheduler().ParallelFor(0, queries.size(), 1, [&search_server, &queries, &array_top_documents](size_t index) {
+		array_top_documents[index] = search_server.FindTopDocuments(execution::par, queries[index]);
 		});
 	return array_top_documents;
 }
@@ -1,6 +1,8 @@
 #include <set>
 #include <string>
 #include <map>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 #include <string_view>
 
@@ -11,12 +13,15 @@ using namespace std;
 
 void RemoveDuplicates(SearchServer& search_server) {
     set<int> id_for_deletion;
-    map<set<string_view>, int> documents_on_server;
+    map<vector<string_view>, int> documents_on_server;
     for (const int document_id : search_server) {
-        set<string_view> words;
-        for (auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
-            words.insert(word);
+        const auto word_frequencies = search_server.GetWordFrequencies(document_id);
+        vector<string_view> words;
+        words.reserve(word_frequencies.size());
+        for (const auto [word, freq] : word_frequencies) {
+            words.push_back(word);
         }
+        sort(words.begin(), words.end());
         const auto it = documents_on_server.find(words);
         if (it != documents_on_server.end()) {
             if (it->second < document_id) {
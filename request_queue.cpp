@@ -11,9 +11,7 @@ RequestQueue::RequestQueue(const SearchServer& search_server) :server(search_ser
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+    return AddFindRequest(raw_query, DocumentStatusIs{ status });
 }
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
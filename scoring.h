@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+const size_t SCORING_BLOCK_SIZE = 64;
+
+// Статистика коллекции на момент запроса, общая для всех его термов
+struct CorpusStats {
+    int document_count = 0;
+    double average_word_count = 0.0;
+    const std::uint32_t* word_counts = nullptr;
+};
+
+// Модель релевантности - параметр шаблона поиска. Для каждого терма запроса создаётся
+// TermScorer, который считает вклад терма сразу для блока постингов. Циклы без ветвлений
+// по непрерывным массивам, чтобы компилятор их векторизовал
+
+struct TfIdf {
+    class TermScorer {
+    public:
+        TermScorer(const CorpusStats& stats, size_t document_freq)
+            : inverse_document_freq_(std::log(stats.document_count * 1.0 / document_freq)) {
+        }
+
+        void ScoreBlock(const int* slots, const double* term_freqs, size_t count, double* scores) const {
+            for (size_t i = 0; i < count; ++i) {
+                scores[i] = term_freqs[i] * inverse_document_freq_;
+            }
+        }
+
+    private:
+        double inverse_document_freq_;
+    };
+};
+
+struct Bm25 {
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    class TermScorer {
+    public:
+        TermScorer(const CorpusStats& stats, size_t document_freq)
+            : inverse_document_freq_(std::log(1.0 + (stats.document_count - document_freq + 0.5) / (document_freq + 0.5)))
+            , length_norm_base_(K1 * (1.0 - B))
+            , length_norm_scale_(stats.average_word_count > 0.0 ? K1 * B / stats.average_word_count : 0.0)
+            , word_counts_(stats.word_counts) {
+        }
+
+        void ScoreBlock(const int* slots, const double* term_freqs, size_t count, double* scores) const {
+            for (size_t i = 0; i < count; ++i) {
+                const double word_count = word_counts_[slots[i]];
+                const double term_count = term_freqs[i] * word_count;
+                const double length_norm = length_norm_base_ + length_norm_scale_ * word_count;
+                scores[i] = inverse_document_freq_ * term_count * (K1 + 1.0) / (term_count + length_norm);
+            }
+        }
+
+    private:
+        double inverse_document_freq_;
+        double length_norm_base_;
+        double length_norm_scale_;
+        const std::uint32_t* word_counts_;
+    };
+};
@@ -9,107 +9,223 @@
 #include <complex>
 #include <iostream>
 #include <algorithm>
+#include <bit>
 #include <execution>
 #include <string_view>
 
 using namespace std;
 
-SearchServer::SearchServer(const string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text)) {
+namespace {
+
+// Термы документа и запроса отсортированы по номеру, общие находятся слиянием
+template <typename Callback>
+void ForEachCommonTerm(const span<const ForwardIndex::Entry> entries, const pmr::vector<int>& terms, Callback callback) {
+    auto entry = entries.begin();
+    auto term = terms.begin();
+    while (entry != entries.end() && term != terms.end()) {
+        if (entry->term_id < *term) {
+            ++entry;
+        }
+        else if (*term < entry->term_id) {
+            ++term;
+        }
+        else {
+            callback(*term);
+            ++entry;
+            ++term;
+        }
+    }
+}
+
+}
+
+SearchServer::MemoryResources::MemoryResources(pmr::memory_resource* upstream)
+    : resource(upstream ? upstream : &default_pool)
+    , total(resource)
+    , stop_words(&total)
+    , dictionary(&total)
+    , postings(&total)
+    , forward_index(&total)
+    , documents(&total)
+    , columns(&total) {
+}
+
+SearchServer::SearchServer(const string& stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(SplitIntoWords(stop_words_text), resource) {
 }
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_slots_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
+    if (memory_budget_ != 0 && memory_->total.GetBytes() >= memory_budget_) {
+        throw length_error("Memory budget exceeded"s);
+    }
     const auto words = SplitIntoWordsNoStop(document);
 
+    vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (const string_view word : words) {
+        term_ids.push_back(AddTerm(word));
+    }
+
+    const int slot = columns_.Add(document_id, status, ComputeAverageRating(ratings), static_cast<uint32_t>(words.size()));
+    forward_index_.Add(term_ids);
     const double inv_word_count = 1.0 / words.size();
-    for (const string& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        id_word_frequencies_[document_id][word] += inv_word_count;
+    const auto entries = forward_index_.GetEntries(slot);
+    for (const auto [term_id, count] : entries) {
+        term_postings_[term_id].Add(slot, count * inv_word_count);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    posting_count_ += entries.size();
+    total_word_count_ += words.size();
+    document_slots_.emplace(document_id, slot);
     document_ids_.insert(document_id);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
-}
-
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
-}
-
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_slots_.size();
 }
 
-set<int>::iterator SearchServer::begin() const {
+pmr::set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-set<int>::iterator SearchServer::end() const {
+pmr::set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
-const map<string, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (document_ids_.count(document_id) == 0)
-        return empty_freq;
-    return id_word_frequencies_.at(document_id);
+WordFrequenciesView SearchServer::GetWordFrequencies(int document_id) const {
+    const auto slot_it = document_slots_.find(document_id);
+    if (slot_it == document_slots_.end()) {
+        return {};
+    }
+    const int slot = slot_it->second;
+    return { forward_index_.GetEntries(slot), term_words_, columns_.GetWordCount(slot) };
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    id_word_frequencies_.erase(document_id);
-    documents_.erase(document_id);
+    const auto slot_it = document_slots_.find(document_id);
+    if (slot_it == document_slots_.end()) {
+        return;
+    }
+    const int slot = slot_it->second;
+
+    total_word_count_ -= columns_.GetWordCount(slot);
+    columns_.Remove(slot);
+    const auto entries = forward_index_.GetEntries(slot);
+    for (const auto [term_id, _] : entries) {
+        term_postings_[term_id].Remove(columns_.GetAliveBitmap());
+    }
+    posting_count_ -= entries.size();
+    forward_index_.Remove(slot);
+    document_slots_.erase(slot_it);
     document_ids_.erase(document_id);
+    // Иначе столбцы, маски и фильтры запросов росли бы с числом когда-либо добавленных документов
+    if (columns_.GetSlotCount() - columns_.GetLiveCount() > columns_.GetSlotCount() / 2) {
+        CompactSlots();
+    }
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
-    if (document_ids_.count(document_id) == 0) {
-        throw std::out_of_range("ID нет!");
+void SearchServer::CompactSlots() {
+    const vector<int> new_slots = columns_.Compact();
+    forward_index_.Renumber(new_slots);
+    for (PostingList& postings : term_postings_) {
+        postings.Renumber(new_slots);
+    }
+    for (auto& [document_id, slot] : document_slots_) {
+        slot = new_slots[slot];
     }
+}
 
-    const auto query = ParseQuery(raw_query);
+MemoryStats SearchServer::GetMemoryStats() const {
+    auto structure = [](const CountingResource& memory, size_t entries) {
+        return StructureMemory{ memory.GetBytes(), memory.GetBlocks(), entries };
+    };
 
-    vector<string_view> matched_words;
-    for (const string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    MemoryStats stats;
+    stats.stop_words = structure(memory_->stop_words, stop_words_.size());
+    stats.dictionary = structure(memory_->dictionary, term_words_.size());
+    stats.postings = structure(memory_->postings, posting_count_);
+    stats.forward_index = structure(memory_->forward_index, forward_index_.GetEntryCount());
+    stats.documents = structure(memory_->documents, document_slots_.size());
+    stats.columns = structure(memory_->columns, columns_.GetSlotCount());
+    stats.bytes = memory_->total.GetBytes();
+    stats.peak_bytes = memory_->total.GetPeakBytes();
+    stats.reserved_bytes = memory_->resource == &memory_->default_pool ? memory_->default_upstream.GetBytes() : 0;
+    stats.budget_bytes = memory_budget_;
+    return stats;
+}
+
+size_t SearchServer::GetMemoryUsage() const {
+    return memory_->total.GetBytes();
+}
+
+PostingStats SearchServer::GetPostingStats() const {
+    PostingStats stats;
+    stats.term_count = term_postings_.size();
+    for (const PostingList& postings : term_postings_) {
+        const size_t size = postings.GetDocumentCount();
+        if (size == 0) {
+            ++stats.empty_terms;
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word_to_document_freqs_.find(word)->first);
-        }
+        stats.posting_count += size;
+        stats.max_postings = max(stats.max_postings, size);
+        ++stats.histogram[min<size_t>(bit_width(size) - 1, POSTING_HISTOGRAM_SIZE - 1)];
     }
-    for (const string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
-            break;
-        }
+    const size_t used_terms = stats.term_count - stats.empty_terms;
+    if (used_terms > 0) {
+        stats.average_postings = static_cast<double>(stats.posting_count) / used_terms;
+    }
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t bytes) {
+    memory_budget_ = bytes;
+}
+
+SearchStats SearchServer::GetSearchStats() const {
+    return { search_counters_->partial_results.load(), search_counters_->deadline_hits.load(), search_counters_->budget_hits.load() };
+}
+
+void SearchServer::SetTaskScheduler(TaskScheduler& scheduler) {
+    scheduler_ = &scheduler;
+}
+
+TaskScheduler& SearchServer::GetTaskScheduler() const {
+    return *scheduler_;
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+    const auto slot_it = document_slots_.find(document_id);
+    if (slot_it == document_slots_.end()) {
+        throw std::out_of_range("ID нет!");
     }
-    return { matched_words, documents_.at(document_id).status };
+    const int slot = slot_it->second;
+
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+
+    vector<string_view> matched_words(query.plus_terms.size());
+    matched_words.resize(MatchTerms(query, slot, matched_words.data()));
+    return { matched_words, columns_.GetStatus(slot) };
 }
 
-bool SearchServer::IsStopWord(const string& word) const {
+bool SearchServer::IsStopWord(const string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-bool SearchServer::IsValidWord(const string& word) {
+bool SearchServer::IsValidWord(const string_view word) {
     return none_of(word.begin(), word.end(), [](char c) {
         return c >= '\0' && c < ' ';
         });
 }
 
-vector<string> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-    vector<string> words;
-    for (const string& word : SplitIntoWords(text)) {
+vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
+    vector<string_view> words;
+    for (const string_view word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
-            throw invalid_argument("Word "s + word + " is invalid"s);
+            throw invalid_argument("Word "s + string(word) + " is invalid"s);
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
@@ -129,39 +245,233 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const string& text) const {
+MatchedDocuments SearchServer::MatchDocuments(const string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocuments(execution::seq, raw_query, document_ids);
+}
+
+bool SearchServer::RanksHigher(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) >= RATE) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) const {
     if (text.empty()) {
         throw invalid_argument("Query word is empty"s);
     }
-    string word = text;
+    string_view word = text;
     bool is_minus = false;
+    bool is_required = false;
     if (word[0] == '-') {
         is_minus = true;
-        word = word.substr(1);
+        word.remove_prefix(1);
+    }
+    else if (word[0] == '+') {
+        is_required = true;
+        word.remove_prefix(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw invalid_argument("Query word "s + text + " is invalid");
+    if (word.empty() || word[0] == '-' || word[0] == '+' || !IsValidWord(word)) {
+        throw invalid_argument("Query word "s + string(text) + " is invalid");
     }
 
-    return { word, is_minus, IsStopWord(word) };
+    return { word, is_minus, is_required, IsStopWord(word) };
+}
+
+SearchServer::Query SearchServer::ParseQuery(const string_view text, pmr::memory_resource* resource) const {
+    return ParseQuery(text, QueryMode::ANY, resource);
 }
 
-SearchServer::Query SearchServer::ParseQuery(const string_view text) const {
-    Query result;
-    for (const string& word : SplitIntoWords(text)) {
+SearchServer::Query SearchServer::ParseQuery(const string_view text, QueryMode mode, pmr::memory_resource* resource) const {
+    pmr::vector<string_view> words(resource);
+    SplitIntoWords(text, words);
+
+    Query result(resource);
+    for (const string_view word : words) {
         const auto query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+                result.minus_words.push_back(query_word.data);
             }
             else {
-                result.plus_words.insert(query_word.data);
+                result.plus_words.push_back(query_word.data);
+                if (query_word.is_required || mode == QueryMode::ALL) {
+                    result.required_words.push_back(query_word.data);
+                }
+            }
+        }
+    }
+    for (auto* query_words : { &result.plus_words, &result.minus_words, &result.required_words }) {
+        sort(query_words->begin(), query_words->end());
+        query_words->erase(unique(query_words->begin(), query_words->end()), query_words->end());
+    }
+    for (const auto& [query_words, query_terms] : { pair{ &result.plus_words, &result.plus_terms }, pair{ &result.minus_words, &result.minus_terms },
+        pair{ &result.required_words, &result.required_terms } }) {
+        for (const string_view word : *query_words) {
+            const int term_id = FindTerm(word);
+            if (term_id >= 0) {
+                query_terms->push_back(term_id);
+            }
+        }
+        sort(query_terms->begin(), query_terms->end());
+    }
+    result.has_missing_required = result.required_terms.size() < result.required_words.size();
+    return result;
+}
+
+int SearchServer::AddTerm(const string_view word) {
+    const auto it = term_ids_.find(word);
+    if (it != term_ids_.end()) {
+        return it->second;
+    }
+    const int term_id = static_cast<int>(term_words_.size());
+    const auto inserted = term_ids_.emplace(piecewise_construct, forward_as_tuple(word), forward_as_tuple(term_id)).first;
+    term_words_.push_back(inserted->first);
+    term_postings_.emplace_back();
+    return term_id;
+}
+
+SearchServer::ExecutionPlan SearchServer::PlanQuery(const Query& query, pmr::memory_resource* resource) const {
+    ExecutionPlan plan(resource);
+    if (query.plus_terms.empty() || query.has_missing_required) {
+        return plan;
+    }
+    const auto by_postings = [this](int lhs, int rhs) {
+        return term_postings_[lhs].size() < term_postings_[rhs].size();
+    };
+    plan.plus_terms.assign(query.plus_terms.begin(), query.plus_terms.end());
+    stable_sort(plan.plus_terms.begin(), plan.plus_terms.end(), by_postings);
+    plan.required_terms.assign(query.required_terms.begin(), query.required_terms.end());
+    stable_sort(plan.required_terms.begin(), plan.required_terms.end(), by_postings);
+    if (query.minus_terms.empty()) {
+        return plan;
+    }
+    // Маска - слово на 64 слота, её нужно выделить и обнулить целиком. Список дешевле, пока он не длиннее маски
+    size_t minus_postings = 0;
+    for (const int term_id : query.minus_terms) {
+        minus_postings += term_postings_[term_id].size();
+    }
+    if (minus_postings <= columns_.GetSlotCount() / 64) {
+        plan.excluded_slots.reserve(minus_postings);
+        for (const int term_id : query.minus_terms) {
+            const auto slots = term_postings_[term_id].Slots();
+            const auto middle = plan.excluded_slots.insert(plan.excluded_slots.end(), slots.begin(), slots.end());
+            inplace_merge(plan.excluded_slots.begin(), middle, plan.excluded_slots.end());
+        }
+        plan.excluded_slots.erase(unique(plan.excluded_slots.begin(), plan.excluded_slots.end()), plan.excluded_slots.end());
+        return plan;
+    }
+    plan.excluded.Resize(columns_.GetSlotCount());
+    for (const int term_id : query.minus_terms) {
+        for (const int slot : term_postings_[term_id].Slots()) {
+            plan.excluded.Set(slot);
+        }
+    }
+    return plan;
+}
+
+QueryPlan SearchServer::ExplainQuery(const string_view raw_query, QueryMode mode) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, mode, arena.Resource());
+    const auto plan = PlanQuery(query, arena.Resource());
+
+    QueryPlan result;
+    result.is_empty = plan.plus_terms.empty();
+    const auto add_step = [this, &result](const string& word, QueryPlanAction action, int term_id, size_t cost) {
+        result.steps.push_back({ word, action, term_postings_[term_id].GetDocumentCount(), cost });
+        result.cost += cost;
+    };
+    if (!result.is_empty) {
+        for (const int term_id : query.minus_terms) {
+            add_step("-"s + string(term_words_[term_id]), QueryPlanAction::EXCLUDE, term_id, term_postings_[term_id].size());
+        }
+        // Первый обязательный список обходится целиком, остальные и плюс-термы - не дальше числа кандидатов
+        result.max_candidates = document_slots_.size();
+        for (const int term_id : plan.required_terms) {
+            const size_t postings = term_postings_[term_id].size();
+            add_step("+"s + string(term_words_[term_id]), QueryPlanAction::REQUIRE, term_id, min(postings, result.max_candidates));
+            result.max_candidates = min(result.max_candidates, postings);
+        }
+        if (plan.required_terms.empty()) {
+            size_t postings_sum = 0;
+            for (const int term_id : plan.plus_terms) {
+                postings_sum += term_postings_[term_id].size();
+            }
+            result.max_candidates = min(result.max_candidates, postings_sum);
+        }
+        for (const int term_id : plan.plus_terms) {
+            const size_t postings = term_postings_[term_id].size();
+            add_step(string(term_words_[term_id]), QueryPlanAction::SCORE, term_id,
+                plan.required_terms.empty() ? postings : min(postings, result.max_candidates));
+        }
+    }
+    for (const auto& [query_words, prefix] : { pair{ &query.minus_words, "-"s }, pair{ &query.plus_words, ""s } }) {
+        for (const string_view word : *query_words) {
+            if (result.is_empty || FindTerm(word) < 0) {
+                result.steps.push_back({ prefix + string(word), QueryPlanAction::SKIP, 0, 0 });
             }
         }
     }
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+int SearchServer::FindTerm(const string_view word) const {
+    const auto it = term_ids_.find(word);
+    if (it == term_ids_.end() || term_postings_[it->second].GetDocumentCount() == 0) {
+        return -1;
+    }
+    return it->second;
+}
+
+CorpusStats SearchServer::GetCorpusStats() const {
+    const int document_count = GetDocumentCount();
+    return { document_count, document_count > 0 ? total_word_count_ * 1.0 / document_count : 0.0, columns_.WordCounts() };
+}
+
+size_t SearchServer::MatchTerms(const Query& query, int slot, string_view* matched_words) const {
+    const auto entries = forward_index_.GetEntries(slot);
+
+    bool has_minus_word = false;
+    ForEachCommonTerm(entries, query.minus_terms, [&has_minus_word](int) {
+        has_minus_word = true;
+        });
+    if (has_minus_word || query.has_missing_required) {
+        return 0;
+    }
+    size_t required_count = 0;
+    ForEachCommonTerm(entries, query.required_terms, [&required_count](int) {
+        ++required_count;
+        });
+    if (required_count < query.required_terms.size()) {
+        return 0;
+    }
+
+    string_view* out = matched_words;
+    ForEachCommonTerm(entries, query.plus_terms, [this, &out](int term_id) {
+        *out++ = term_words_[term_id];
+        });
+    sort(matched_words, out);
+    return out - matched_words;
+}
+
+DocumentFilter SearchServer::MakeDocumentFilter(const DocumentStatusIs& predicate) const {
+    return DocumentFilter(columns_.GetStatusBitmap(predicate.status));
+}
+
+DocumentFilter SearchServer::MakeDocumentFilter(const DocumentRatingBetween& predicate) const {
+    return DocumentFilter(columns_.SelectRatings(predicate.min_rating, predicate.max_rating));
+}
+
+DocumentFilter SearchServer::MakeDocumentFilter(const DocumentIdIn& predicate) const {
+    Bitmap bitmap(columns_.GetSlotCount());
+    for (const int document_id : predicate.ids) {
+        const auto it = document_slots_.find(document_id);
+        if (it != document_slots_.end()) {
+            bitmap.Set(it->second);
+        }
+    }
+    return DocumentFilter(move(bitmap));
 }
\ No newline at end of file
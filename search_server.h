@@ -1,10 +1,17 @@
 #pragma once
 #include "document.h"
+#include "document_columns.h"
+#include "forward_index.h"
+#include "memory_accounting.h"
+#include "posting_list.h"
+#include "scoring.h"
 #include "string_processing.h"
+#include "task_scheduler.h"
 
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <algorithm>
 #include <iostream>
@@ -12,92 +19,254 @@
 #include <string_view>
 #include <deque>
 #include <mutex>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <limits>
+#include <span>
+#include <utility>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double RATE = 1e-6;
 const int BUCKET_COUNT = 5;
+const size_t QUERY_ARENA_SIZE = 2048;
+const size_t MATCH_GRAIN_SIZE = 64;
+const size_t DEADLINE_CHECK_POSTINGS = 1024;
 
 using namespace std::string_literals;
 
 class SearchServer {
 public:
+    // Всё содержимое индекса размещается в resource, который должен пережить сервер.
+    // По умолчанию сервер использует собственный пул с раздельными классами размеров
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words) : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource = nullptr)
+        : memory_(std::make_unique<MemoryResources>(resource))
+        , stop_words_(MakeUniqueNonEmptyStrings(stop_words, &memory_->stop_words))
+        , term_ids_(&memory_->dictionary)
+        , term_words_(&memory_->dictionary)
+        , term_postings_(&memory_->postings)
+        , forward_index_(&memory_->forward_index)
+        , document_slots_(&memory_->documents)
+        , columns_(&memory_->columns)
+        , document_ids_(&memory_->documents)
     {
         if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
             throw std::invalid_argument("Some of stop words are invalid");
         }
     }
 
-    explicit SearchServer(const std::string& stop_words_text);
+    explicit SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* resource = nullptr);
+
+    // Копия должна заново связать term_words_ с ключами словаря и разместиться в своих ресурсах,
+    // поэтому копирование запрещено. При перемещении контейнеры забирают память вместе с ресурсами.
+    // Перемещающее присваивание запрещено: старые контейнеры освобождали бы память в уже уничтоженных ресурсах
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    SearchServer(SearchServer&&) = default;
+    SearchServer& operator=(SearchServer&&) = delete;
+
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        const auto query = ParseQuery(raw_query);
+    // Модель релевантности выбирается параметром шаблона: FindTopDocuments<Bm25>(query)
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const {
+        QueryArena arena;
+        const auto plan = PlanQuery(ParseQuery(raw_query, mode, arena.Resource()), arena.Resource());
 
-        auto matched_documents = FindAllDocuments(query, document_predicate);
+        auto matched_documents = FindAllDocuments<ScoringModel>(plan, document_predicate);
 
-        std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < RATE) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-            });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
+        const size_t result_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(), RanksHigher);
+        matched_documents.resize(result_count);
 
         return matched_documents;
     }
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        const auto query = ParseQuery(raw_query);
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const {
+        QueryArena arena;
+        const auto plan = PlanQuery(ParseQuery(raw_query, mode, arena.Resource()), arena.Resource());
         std::vector<Document> matched_documents;
 
-        if (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>)
-            matched_documents = FindAllDocuments(query, document_predicate);
+        if (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+            matched_documents = FindAllDocuments<ScoringModel>(plan, document_predicate);
         else
-            matched_documents = FindAllDocuments(std::execution::par, query, document_predicate);
+            matched_documents = FindAllDocuments<ScoringModel>(std::execution::par, plan, document_predicate);
+
+        const size_t result_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(), RanksHigher);
+        matched_documents.resize(result_count);
+
+        return matched_documents;
+    }
+
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return FindTopDocuments<ScoringModel>(policy, raw_query, QueryMode::ANY, document_predicate);
+    }
+
+    template <typename ScoringModel = TfIdf, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, QueryMode mode) const {
+        return FindTopDocuments<ScoringModel>(policy, raw_query, mode, DocumentStatusIs{ DocumentStatus::ACTUAL });
+    }
+
+    template <typename ScoringModel = TfIdf, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
+        return FindTopDocuments<ScoringModel>(policy, raw_query, DocumentStatusIs{ status });
+    }
+
+    template <typename ScoringModel = TfIdf, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const {
+        return FindTopDocuments<ScoringModel>(policy, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return FindTopDocuments<ScoringModel>(raw_query, QueryMode::ANY, document_predicate);
+    }
+
+    template <typename ScoringModel = TfIdf>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, QueryMode mode) const {
+        return FindTopDocuments<ScoringModel>(raw_query, mode, DocumentStatusIs{ DocumentStatus::ACTUAL });
+    }
+
+    template <typename ScoringModel = TfIdf>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+        return FindTopDocuments<ScoringModel>(raw_query, DocumentStatusIs{ status });
+    }
+
+    template <typename ScoringModel = TfIdf>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const {
+        return FindTopDocuments<ScoringModel>(raw_query, DocumentStatus::ACTUAL);
+    }
+
+    // Поиск с ограничением по сроку или числу постингов. Когда ограничение исчерпано, подсчёт релевантности
+    // останавливается и возвращаются лучшие из уже найденных документов с пометкой is_partial.
+    // Термы обрабатываются от коротких списков к длинным, поэтому самые редкие слова учитываются первыми
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate>
+    SearchResult Search(const std::string_view raw_query, const SearchOptions& options, DocumentPredicate document_predicate) const {
+        return Search<ScoringModel>(std::execution::seq, raw_query, options, document_predicate);
+    }
+
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate, typename ExecutionPolicy>
+    SearchResult Search(ExecutionPolicy& policy, const std::string_view raw_query, const SearchOptions& options, DocumentPredicate document_predicate) const {
+        QueryArena arena;
+        const auto plan = PlanQuery(ParseQuery(raw_query, options.mode, arena.Resource()), arena.Resource());
+        const SearchBudget budget(options);
+
+        SearchResult result;
+        if (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+            result.documents = FindAllDocuments<ScoringModel>(plan, document_predicate, budget);
+        else
+            result.documents = FindAllDocuments<ScoringModel>(std::execution::par, plan, document_predicate, budget);
+
+        const size_t result_count = std::min<size_t>(result.documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        std::partial_sort(result.documents.begin(), result.documents.begin() + result_count, result.documents.end(), RanksHigher);
+        result.documents.resize(result_count);
+
+        result.is_partial = budget.IsExhausted();
+        if (result.is_partial) {
+            ++search_counters_->partial_results;
+            search_counters_->deadline_hits += budget.IsDeadlineHit();
+            search_counters_->budget_hits += budget.IsBudgetHit();
+        }
+        return result;
+    }
+
+    template <typename ScoringModel = TfIdf>
+    SearchResult Search(const std::string_view raw_query, const SearchOptions& options) const {
+        return Search<ScoringModel>(raw_query, options, DocumentStatusIs{ DocumentStatus::ACTUAL });
+    }
+
+    template <typename ScoringModel = TfIdf, typename ExecutionPolicy>
+    SearchResult Search(ExecutionPolicy& policy, const std::string_view raw_query, const SearchOptions& options) const {
+        return Search<ScoringModel>(policy, raw_query, options, DocumentStatusIs{ DocumentStatus::ACTUAL });
+    }
 
-        std::sort(std::execution::par, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < RATE) {
-                return lhs.rating > rhs.rating;
+    SearchStats GetSearchStats() const;
+
+    // Страница выдачи после курсора after. Документы перебираются по одному слиянием списков плюс-термов
+    // и сразу попадают в кучу из page_size + 1 лучших документов, ранжированных ниже курсора:
+    // память запроса - курсор на терм и куча, вся выдача не собирается и не сортируется
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate>
+    SearchPage FindPage(const std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate, const SearchCursor& after, size_t page_size) const {
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive"s);
+        }
+        QueryArena arena;
+        const auto plan = PlanQuery(ParseQuery(raw_query, mode, arena.Resource()), arena.Resource());
+
+        std::vector<Document> top;
+        top.reserve(page_size + 1);
+        ForEachMatchedDocument<ScoringModel>(plan, document_predicate, arena.Resource(), [&after, &top, page_size](const Document& document) {
+            if (!after.is_start_ && !RanksHigher(after.last_, document)) {
+                return;
             }
-            else {
-                return lhs.relevance > rhs.relevance;
+            top.push_back(document);
+            std::push_heap(top.begin(), top.end(), RanksHigher);
+            if (top.size() > page_size + 1) {
+                std::pop_heap(top.begin(), top.end(), RanksHigher);
+                top.pop_back();
             }
             });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        std::sort_heap(top.begin(), top.end(), RanksHigher);
+
+        SearchPage page;
+        page.is_last = top.size() <= page_size;
+        if (!page.is_last) {
+            top.pop_back();
         }
+        page.documents = std::move(top);
+        if (!page.documents.empty()) {
+            page.next = SearchCursor(page.documents.back());
+        }
+        return page;
+    }
 
-        return matched_documents;
+    template <typename ScoringModel = TfIdf, typename DocumentPredicate>
+    SearchPage FindPage(const std::string_view raw_query, DocumentPredicate document_predicate, const SearchCursor& after, size_t page_size) const {
+        return FindPage<ScoringModel>(raw_query, QueryMode::ANY, document_predicate, after, page_size);
     }
 
-    template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-            });
+    template <typename ScoringModel = TfIdf>
+    SearchPage FindPage(const std::string_view raw_query, DocumentStatus status, const SearchCursor& after, size_t page_size) const {
+        return FindPage<ScoringModel>(raw_query, DocumentStatusIs{ status }, after, page_size);
     }
 
-    template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const {
-        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    template <typename ScoringModel = TfIdf>
+    SearchPage FindPage(const std::string_view raw_query, const SearchCursor& after, size_t page_size) const {
+        return FindPage<ScoringModel>(raw_query, DocumentStatus::ACTUAL, after, page_size);
     }
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+    // План выполнения запроса со стоимостью каждого шага, для разбора медленных запросов
+    QueryPlan ExplainQuery(const std::string_view raw_query, QueryMode mode = QueryMode::ANY) const;
+
     int GetDocumentCount() const;
-    std::set<int>::iterator begin()const;
-    std::set<int>::iterator end()const;
-    const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
+    std::pmr::set<int>::const_iterator begin()const;
+    std::pmr::set<int>::const_iterator end()const;
+    WordFrequenciesView GetWordFrequencies(int document_id) const;
     void RemoveDocument(int document_id);
 
+    // Размеры структур индекса за O(1), можно опрашивать как любой другой константный метод.
+    // GetMemoryUsage читает только атомарные счётчики и безопасен параллельно с изменением индекса
+    MemoryStats GetMemoryStats() const;
+    size_t GetMemoryUsage() const;
+    // Обходит все термы словаря
+    PostingStats GetPostingStats() const;
+    // Параллельные версии методов выполняются в планировщике, по умолчанию - в общем TaskScheduler::Default().
+    // Планировщик должен пережить сервер; несколько серверов могут делить ядра, получив разные планировщики
+    void SetTaskScheduler(TaskScheduler& scheduler);
+    TaskScheduler& GetTaskScheduler() const;
+
+    // Если занятая индексом память достигла бюджета, AddDocument бросает std::length_error.
+    // 0 - без ограничения
+    void SetMemoryBudget(size_t bytes);
+
     template <class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy& policy, int document_id) {
         RemoveDocument(document_id);
@@ -107,63 +276,222 @@ public:
 
     template <class ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy& policy, const std::string_view raw_query, int document_id) const {
-        if (document_ids_.count(document_id) == 0) {
-            throw std::out_of_range("ID нет!");
-        }
+        return MatchDocument(raw_query, document_id);
+    }
 
-        const auto query = ParseQuery(raw_query);
+    MatchedDocuments MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
 
-        std::vector<std::string_view> matched_words;
-        std::mutex mut;
+    // Запрос разбирается один раз, документы сопоставляются независимо друг от друга без блокировок.
+    // Параллельная версия выполняется в планировщике сервера
+    template <class ExecutionPolicy>
+    MatchedDocuments MatchDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+        std::vector<int> slots;
+        slots.reserve(document_ids.size());
+        for (const int document_id : document_ids) {
+            const auto slot_it = document_slots_.find(document_id);
+            if (slot_it == document_slots_.end()) {
+                throw std::out_of_range("ID нет!");
+            }
+            slots.push_back(slot_it->second);
+        }
 
-        std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, document_id, &matched_words, &mut](const std::string& word) {
-            if (word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id))
-                std::lock_guard guard(mut);
-            matched_words.push_back(word_to_document_freqs_.find(word)->first);
-            });
+        QueryArena arena;
+        const auto query = ParseQuery(raw_query, arena.Resource());
+        const size_t stride = query.plus_terms.size();
 
-        std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, document_id, &matched_words, &mut](const std::string& word) {
-            if (word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id)) {
-                std::lock_guard guard(mut);
-                matched_words.clear();
-                return;
+        const bool is_parallel = !std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+        const auto for_each_document = [this, &slots, is_parallel](const auto& body) {
+            if (is_parallel) {
+                scheduler_->ParallelFor(0, slots.size(), MATCH_GRAIN_SIZE, body);
+            }
+            else {
+                for (size_t index = 0; index < slots.size(); ++index) {
+                    body(index);
+                }
             }
+        };
+
+        // Каждый документ пишет в свой участок буфера, затем участки сдвигаются встык
+        std::vector<std::string_view> matched_words(slots.size() * stride);
+        std::vector<size_t> counts(slots.size());
+        for_each_document([this, &query, &slots, &matched_words, &counts, stride](size_t index) {
+            counts[index] = MatchTerms(query, slots[index], matched_words.data() + index * stride);
             });
 
-        return { matched_words, documents_.at(document_id).status };
+        MatchedDocuments result;
+        result.document_ids = document_ids;
+        result.statuses.reserve(slots.size());
+        for (const int slot : slots) {
+            result.statuses.push_back(columns_.GetStatus(slot));
+        }
+        result.word_offsets.resize(slots.size() + 1);
+        std::inclusive_scan(counts.begin(), counts.end(), result.word_offsets.begin() + 1);
+        result.words.resize(result.word_offsets.back());
+        for_each_document([&result, &matched_words, &counts, stride](size_t index) {
+            const auto first = matched_words.begin() + index * stride;
+            std::copy(first, first + counts[index], result.words.begin() + result.word_offsets[index]);
+            });
+        return result;
     }
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // Собственный пул и счётчики лежат в куче: контейнеры индекса хранят указатели на них,
+    // и при перемещении сервера эти указатели остаются действительными
+    struct MemoryResources {
+        explicit MemoryResources(std::pmr::memory_resource* upstream);
+
+        CountingResource default_upstream{ std::pmr::new_delete_resource() };
+        std::pmr::unsynchronized_pool_resource default_pool{ &default_upstream };
+        std::pmr::memory_resource* resource;
+        // Каждая структура индекса выделяет память через свой счётчик, все счётчики - через общий
+        CountingResource total;
+        CountingResource stop_words;
+        CountingResource dictionary;
+        CountingResource postings;
+        CountingResource forward_index;
+        CountingResource documents;
+        CountingResource columns;
+    };
+
+    struct SearchCounters {
+        std::atomic_size_t partial_results = 0;
+        std::atomic_size_t deadline_hits = 0;
+        std::atomic_size_t budget_hits = 0;
     };
-    std::map<std::string, double> empty_freq;
-    std::map<int, std::map<std::string, double>> id_word_frequencies_;
-    const std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
-    bool IsStopWord(const std::string& word) const;
-    static bool IsValidWord(const std::string& word);
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string_view text) const;
+
+    // Объявлен первым, чтобы ресурсы уничтожались после всех контейнеров
+    std::unique_ptr<MemoryResources> memory_;
+    std::pmr::set<std::pmr::string, std::less<>> stop_words_;
+    struct TermHash {
+        using is_transparent = void;
+
+        size_t operator()(const std::string_view word) const {
+            return std::hash<std::string_view>{}(word);
+        }
+    };
+
+    // Словарь: слово -> номер терма. Номера не переиспользуются, term_words_ ссылается на ключи словаря
+    std::pmr::unordered_map<std::pmr::string, int, TermHash, std::equal_to<>> term_ids_;
+    std::pmr::vector<std::string_view> term_words_;
+    // Обратный индекс: номер терма -> слоты документов и частоты терма в них
+    std::pmr::vector<PostingList> term_postings_;
+    ForwardIndex forward_index_;
+    std::pmr::map<int, int> document_slots_;
+    DocumentColumns columns_;
+    std::pmr::set<int> document_ids_;
+    size_t total_word_count_ = 0;
+    size_t posting_count_ = 0;
+    size_t memory_budget_ = 0;
+    TaskScheduler* scheduler_ = &TaskScheduler::Default();
+    std::unique_ptr<SearchCounters> search_counters_ = std::make_unique<SearchCounters>();
+    bool IsStopWord(const std::string_view word) const;
+    static bool IsValidWord(const std::string_view word);
+    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // Порядок выдачи: релевантность, при равной релевантности рейтинг, затем id
+    static bool RanksHigher(const Document& lhs, const Document& rhs);
+
+    // Буфер на стеке под разбор одного запроса: в обычном случае запрос разбирается без обращений к куче
+    class QueryArena {
+    public:
+        QueryArena() : resource_(buffer_.data(), buffer_.size()) {}
+        QueryArena(const QueryArena&) = delete;
+        QueryArena& operator=(const QueryArena&) = delete;
+
+        std::pmr::memory_resource* Resource() {
+            return &resource_;
+        }
+
+    private:
+        std::array<std::byte, QUERY_ARENA_SIZE> buffer_;
+        std::pmr::monotonic_buffer_resource resource_;
+    };
+
     struct QueryWord {
-        std::string data;
+        std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(const std::string& text) const;
+    QueryWord ParseQueryWord(const std::string_view text) const;
 
+    // Слова запроса ссылаются на исходную строку запроса, отсортированы и без повторов.
+    // Термы - номера тех слов, которые встречаются хотя бы в одном документе, по возрастанию.
+    // Обязательные слова входят и в плюс-слова; если какого-то из них нет в индексе, выставлен has_missing_required
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource), minus_words(resource), required_words(resource)
+            , plus_terms(resource), minus_terms(resource), required_terms(resource) {}
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<std::string_view> required_words;
+        std::pmr::vector<int> plus_terms;
+        std::pmr::vector<int> minus_terms;
+        std::pmr::vector<int> required_terms;
+        bool has_missing_required = false;
     };
 
-    Query ParseQuery(const std::string_view text) const;
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    Query ParseQuery(const std::string_view text, std::pmr::memory_resource* resource) const;
+    Query ParseQuery(const std::string_view text, QueryMode mode, std::pmr::memory_resource* resource) const;
+
+    // Плюс-термы и обязательные термы в порядке возрастания длины списков документов и слоты
+    // с минус-словами, собранные до подсчёта релевантности. Короткие списки минус-слов сливаются
+    // в отсортированный excluded_slots, маска excluded строится, только если она меньше такого списка.
+    // Если запрос заведомо пуст (нет плюс-термов или обязательного слова нет в индексе), план пуст
+    struct ExecutionPlan {
+        explicit ExecutionPlan(std::pmr::memory_resource* resource)
+            : plus_terms(resource), required_terms(resource), excluded_slots(resource), excluded(resource) {}
+
+        std::pmr::vector<int> plus_terms;
+        std::pmr::vector<int> required_terms;
+        std::pmr::vector<int> excluded_slots;
+        Bitmap excluded;
+    };
+
+    // Проверка слотов с минус-словами при обходе по возрастанию слотов: по маске
+    // или галопом по списку excluded_slots от предыдущей найденной позиции
+    class ExclusionCursor {
+    public:
+        explicit ExclusionCursor(const ExecutionPlan& plan) : plan_(plan) {}
+
+        bool IsExcluded(int slot) {
+            if (plan_.excluded.Size() > 0) {
+                return plan_.excluded.Test(slot);
+            }
+            if (plan_.excluded_slots.empty()) {
+                return false;
+            }
+            position_ = GallopTo(plan_.excluded_slots, position_, slot);
+            return position_ < plan_.excluded_slots.size() && plan_.excluded_slots[position_] == slot;
+        }
+
+    private:
+        const ExecutionPlan& plan_;
+        size_t position_ = 0;
+    };
+
+    ExecutionPlan PlanQuery(const Query& query, std::pmr::memory_resource* resource) const;
+    int AddTerm(const std::string_view word);
+    // Перенумеровывает живые документы подряд, когда удалённых слотов больше половины
+    void CompactSlots();
+    int FindTerm(const std::string_view word) const;
+    CorpusStats GetCorpusStats() const;
+    size_t MatchTerms(const Query& query, int slot, std::string_view* matched_words) const;
+
+    DocumentFilter MakeDocumentFilter(const DocumentStatusIs& predicate) const;
+    DocumentFilter MakeDocumentFilter(const DocumentRatingBetween& predicate) const;
+    DocumentFilter MakeDocumentFilter(const DocumentIdIn& predicate) const;
+
+    // Маски статусов, рейтингов и id не содержат удалённых слотов, здесь их нужно пропустить явно
+    template <typename DocumentPredicate>
+    auto MakeDocumentFilter(const DocumentPredicate& document_predicate) const {
+        return [this, &document_predicate](int slot) {
+            return columns_.IsAlive(slot) && document_predicate(columns_.GetId(slot), columns_.GetStatus(slot), columns_.GetRating(slot));
+        };
+    }
 
     template <typename Key, typename Value>
     class ConcurrentMap {
@@ -234,72 +562,302 @@ private:
         std::map<Key, Value> answer_;
     };
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-        ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
+    // Бюджет запроса проверяется перед каждым блоком постингов, срок - раз в DEADLINE_CHECK_POSTINGS постингов.
+    // Исчерпанный бюджет останавливает подсчёт релевантности во всех потоках запроса
+    class SearchBudget {
+    public:
+        explicit SearchBudget(const SearchOptions& options)
+            : deadline_(options.deadline)
+            , max_postings_(options.max_postings) {
+        }
 
-        std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-            [this, &document_to_relevance, &document_predicate](const std::string& word) {
-                if (word_to_document_freqs_.count(word)) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        if (documents_.count(document_id) == 0)
-                            continue;
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                        }
-                    }
+        bool Charge(size_t postings) const {
+            if (exhausted_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            const size_t used = used_.fetch_add(postings, std::memory_order_relaxed) + postings;
+            if (max_postings_ != 0 && used > max_postings_) {
+                budget_hit_.store(true, std::memory_order_relaxed);
+                exhausted_.store(true, std::memory_order_relaxed);
+                return false;
+            }
+            const size_t previous = used - postings;
+            if ((previous == 0 || previous / DEADLINE_CHECK_POSTINGS != used / DEADLINE_CHECK_POSTINGS)
+                && std::chrono::steady_clock::now() >= deadline_) {
+                deadline_hit_.store(true, std::memory_order_relaxed);
+                exhausted_.store(true, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        bool IsExhausted() const {
+            return exhausted_.load(std::memory_order_relaxed);
+        }
+
+        bool IsDeadlineHit() const {
+            return deadline_hit_.load(std::memory_order_relaxed);
+        }
+
+        bool IsBudgetHit() const {
+            return budget_hit_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::chrono::steady_clock::time_point deadline_;
+        size_t max_postings_;
+        mutable std::atomic_size_t used_ = 0;
+        mutable std::atomic_bool exhausted_ = false;
+        mutable std::atomic_bool deadline_hit_ = false;
+        mutable std::atomic_bool budget_hit_ = false;
+    };
+
+    struct UnlimitedBudget {
+        bool Charge(size_t) const {
+            return true;
+        }
+
+        bool IsExhausted() const {
+            return false;
+        }
+    };
+
+    // Постинги терма обрабатываются блоками: вклад считается для всего блока сразу,
+    // затем прошедшие фильтр документы получают его в accumulate(slot, score)
+    template <typename ScoringModel, typename DocumentFilterType, typename Accumulate, typename Budget>
+    void ScoreTerm(const CorpusStats& stats, int term_id, const ExecutionPlan& plan, const DocumentFilterType& document_filter,
+        Accumulate accumulate, const Budget& budget) const {
+        const PostingList& postings = term_postings_[term_id];
+        ExclusionCursor excluded(plan);
+        const typename ScoringModel::TermScorer scorer(stats, postings.GetDocumentCount());
+        std::array<double, SCORING_BLOCK_SIZE> scores;
+        for (size_t begin = 0; begin < postings.size(); begin += SCORING_BLOCK_SIZE) {
+            const size_t count = std::min(SCORING_BLOCK_SIZE, postings.size() - begin);
+            if (!budget.Charge(count)) {
+                return;
+            }
+            const int* slots = postings.Slots().data() + begin;
+            scorer.ScoreBlock(slots, postings.TermFreqs().data() + begin, count, scores.data());
+            for (size_t i = 0; i < count; ++i) {
+                if (!excluded.IsExcluded(slots[i]) && document_filter(slots[i])) {
+                    accumulate(slots[i], scores[i]);
                 }
-            });
+            }
+        }
+    }
 
-        std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_to_relevance](const std::string& word) {
-                if (word_to_document_freqs_.count(word)) {
-                    for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                        document_to_relevance.erase(document_id);
+    // Кандидаты - пересечение списков обязательных термов, от короткого к длинному. Релевантность
+    // считается только для кандидатов: постинги каждого плюс-терма находятся галопом по его списку
+    template <typename ScoringModel, typename DocumentPredicate, typename Budget>
+    std::vector<Document> FindAllRequiredDocuments(const ExecutionPlan& plan, DocumentPredicate document_predicate, const Budget& budget) const {
+        const auto& document_filter = MakeDocumentFilter(document_predicate);
+        std::vector<int> candidates;
+        ExclusionCursor excluded(plan);
+        for (const int slot : term_postings_[plan.required_terms.front()].Slots()) {
+            if (!excluded.IsExcluded(slot) && document_filter(slot)) {
+                candidates.push_back(slot);
+            }
+        }
+        for (auto term = plan.required_terms.begin() + 1; term != plan.required_terms.end() && !candidates.empty(); ++term) {
+            const auto slots = term_postings_[*term].Slots();
+            size_t position = 0;
+            size_t kept = 0;
+            for (const int slot : candidates) {
+                position = GallopTo(slots, position, slot);
+                if (position == slots.size()) {
+                    break;
+                }
+                if (slots[position] == slot) {
+                    candidates[kept++] = slot;
+                }
+            }
+            candidates.resize(kept);
+        }
+
+        std::vector<double> relevances(candidates.size());
+        const CorpusStats stats = GetCorpusStats();
+        std::array<int, SCORING_BLOCK_SIZE> block_slots;
+        std::array<double, SCORING_BLOCK_SIZE> block_term_freqs;
+        std::array<size_t, SCORING_BLOCK_SIZE> block_candidates;
+        std::array<double, SCORING_BLOCK_SIZE> scores;
+        for (const int term_id : plan.plus_terms) {
+            const PostingList& postings = term_postings_[term_id];
+            const auto slots = postings.Slots();
+            const typename ScoringModel::TermScorer scorer(stats, postings.GetDocumentCount());
+            size_t count = 0;
+            const auto score_block = [&] {
+                scorer.ScoreBlock(block_slots.data(), block_term_freqs.data(), count, scores.data());
+                for (size_t i = 0; i < count; ++i) {
+                    relevances[block_candidates[i]] += scores[i];
+                }
+                count = 0;
+            };
+
+            size_t position = 0;
+            for (size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+                if (candidate % SCORING_BLOCK_SIZE == 0 && !budget.Charge(std::min(SCORING_BLOCK_SIZE, candidates.size() - candidate))) {
+                    break;
+                }
+                position = GallopTo(slots, position, candidates[candidate]);
+                if (position == slots.size()) {
+                    break;
+                }
+                if (slots[position] == candidates[candidate]) {
+                    block_slots[count] = slots[position];
+                    block_term_freqs[count] = postings.TermFreqs()[position];
+                    block_candidates[count] = candidate;
+                    if (++count == SCORING_BLOCK_SIZE) {
+                        score_block();
                     }
                 }
-            });
+            }
+            score_block();
+            if (budget.IsExhausted()) {
+                break;
+            }
+        }
 
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        matched_documents.reserve(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            matched_documents.push_back({ columns_.GetId(candidates[i]), relevances[i], columns_.GetRating(candidates[i]) });
         }
         return matched_documents;
     }
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-        std::map<int, double> document_to_relevance;
+    // Документ за документом: у каждого плюс-терма курсор по его списку, следующий кандидат - наименьший
+    // слот под курсорами или, если есть обязательные термы, очередной слот самого короткого из них.
+    // Остальные списки догоняют кандидата галопом. Релевантность складывается в порядке плана,
+    // как в FindAllDocuments, и готовый документ сразу передаётся в consume
+    template <typename ScoringModel, typename DocumentPredicate, typename Consume>
+    void ForEachMatchedDocument(const ExecutionPlan& plan, DocumentPredicate document_predicate, std::pmr::memory_resource* resource,
+        Consume consume) const {
+        if (plan.plus_terms.empty()) {
+            return;
+        }
+        struct TermCursor {
+            std::span<const int> slots;
+            std::span<const double> term_freqs;
+            typename ScoringModel::TermScorer scorer;
+            size_t position;
+        };
 
-        for (const std::string& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+        const auto& document_filter = MakeDocumentFilter(document_predicate);
+        const CorpusStats stats = GetCorpusStats();
+        std::pmr::vector<TermCursor> cursors(resource);
+        cursors.reserve(plan.plus_terms.size());
+        for (const int term_id : plan.plus_terms) {
+            const PostingList& postings = term_postings_[term_id];
+            cursors.push_back({ postings.Slots(), postings.TermFreqs(), typename ScoringModel::TermScorer(stats, postings.GetDocumentCount()), 0 });
+        }
+        const bool has_required = !plan.required_terms.empty();
+        std::pmr::vector<std::pair<std::span<const int>, size_t>> required(resource);
+        for (const int term_id : plan.required_terms) {
+            required.push_back({ term_postings_[term_id].Slots(), 0 });
+        }
+
+        ExclusionCursor excluded(plan);
+        while (true) {
+            int slot = std::numeric_limits<int>::max();
+            if (has_required) {
+                auto& [slots, position] = required.front();
+                if (position == slots.size()) {
+                    break;
+                }
+                slot = slots[position++];
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                if (documents_.count(document_id) == 0)
-                    continue;
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            else {
+                for (const TermCursor& cursor : cursors) {
+                    if (cursor.position < cursor.slots.size()) {
+                        slot = std::min(slot, cursor.slots[cursor.position]);
+                    }
+                }
+                if (slot == std::numeric_limits<int>::max()) {
+                    break;
                 }
             }
-        }
 
-        for (const std::string& word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+            bool matches = !excluded.IsExcluded(slot) && document_filter(slot);
+            for (auto term = required.begin() + (has_required ? 1 : 0); matches && term != required.end(); ++term) {
+                auto& [slots, position] = *term;
+                position = GallopTo(slots, position, slot);
+                matches = position < slots.size() && slots[position] == slot;
+            }
+            if (has_required && !matches) {
                 continue;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+
+            double relevance = 0.0;
+            for (TermCursor& cursor : cursors) {
+                if (has_required) {
+                    cursor.position = GallopTo(cursor.slots, cursor.position, slot);
+                }
+                if (cursor.position < cursor.slots.size() && cursor.slots[cursor.position] == slot) {
+                    if (matches) {
+                        double score;
+                        cursor.scorer.ScoreBlock(&cursor.slots[cursor.position], &cursor.term_freqs[cursor.position], 1, &score);
+                        relevance += score;
+                    }
+                    ++cursor.position;
+                }
+            }
+            if (matches) {
+                consume(Document{ columns_.GetId(slot), relevance, columns_.GetRating(slot) });
+            }
+        }
+    }
+
+    template <typename ScoringModel, typename DocumentPredicate, typename Budget = UnlimitedBudget>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const ExecutionPlan& plan, DocumentPredicate document_predicate,
+        const Budget& budget = {}) const {
+        if (plan.plus_terms.empty()) {
+            return {};
+        }
+        if (!plan.required_terms.empty()) {
+            return FindAllRequiredDocuments<ScoringModel>(plan, document_predicate, budget);
+        }
+        ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
+        const auto& document_filter = MakeDocumentFilter(document_predicate);
+        const CorpusStats stats = GetCorpusStats();
+
+        scheduler_->ParallelFor(0, plan.plus_terms.size(), 1,
+            [this, &plan, &document_to_relevance, &document_filter, &stats, &budget](size_t index) {
+                ScoreTerm<ScoringModel>(stats, plan.plus_terms[index], plan, document_filter, [&document_to_relevance](int slot, double score) {
+                    document_to_relevance[slot] += score;
+                    }, budget);
+            });
+
+        std::vector<Document> matched_documents;
+        for (const auto [slot, relevance] : document_to_relevance) {
+            matched_documents.push_back({ columns_.GetId(slot), relevance, columns_.GetRating(slot) });
+        }
+        return matched_documents;
+    }
+
+    template <typename ScoringModel, typename DocumentPredicate, typename Budget = UnlimitedBudget>
+    std::vector<Document> FindAllDocuments(const ExecutionPlan& plan, DocumentPredicate document_predicate, const Budget& budget = {}) const {
+        if (plan.plus_terms.empty()) {
+            return {};
+        }
+        if (!plan.required_terms.empty()) {
+            return FindAllRequiredDocuments<ScoringModel>(plan, document_predicate, budget);
+        }
+        std::map<int, double> document_to_relevance;
+        const auto& document_filter = MakeDocumentFilter(document_predicate);
+        const CorpusStats stats = GetCorpusStats();
+
+        for (const int term_id : plan.plus_terms) {
+            ScoreTerm<ScoringModel>(stats, term_id, plan, document_filter, [&document_to_relevance](int slot, double score) {
+                document_to_relevance[slot] += score;
+                }, budget);
+            if (budget.IsExhausted()) {
+                break;
             }
         }
 
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        for (const auto [slot, relevance] : document_to_relevance) {
+            matched_documents.push_back({ columns_.GetId(slot), relevance, columns_.GetRating(slot) });
         }
         return matched_documents;
     }
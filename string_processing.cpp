@@ -7,23 +7,8 @@
 
 using namespace std;
 
-vector<string> SplitIntoWords(const string_view text) {
-    vector<string> words;
-    string word;
-    for (const char c : text) {
-        if (c == ' ') {
-            if (!word.empty()) {
-                words.push_back(word);
-                word.clear();
-            }
-        }
-        else {
-            word += c;
-        }
-    }
-    if (!word.empty()) {
-        words.push_back(word);
-    }
-
+vector<string_view> SplitIntoWords(const string_view text) {
+    vector<string_view> words;
+    SplitIntoWords(text, words);
     return words;
-}
\ No newline at end of file
+}
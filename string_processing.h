@@ -4,16 +4,29 @@
 #include <vector>
 #include <set>
 #include <string_view>
+#include <memory_resource>
 
-std::vector<std::string> SplitIntoWords(const std::string_view text);
+std::vector<std::string_view> SplitIntoWords(const std::string_view text);
+
+template <typename Container>
+void SplitIntoWords(const std::string_view text, Container& words) {
+    size_t pos = text.find_first_not_of(' ');
+    while (pos != std::string_view::npos) {
+        const size_t space = text.find(' ', pos);
+        words.push_back(text.substr(pos, space - pos));
+        pos = text.find_first_not_of(' ', space);
+    }
+}
 
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings) {
-        if (!str.empty()) {
-            non_empty_strings.insert(str);
+std::pmr::set<std::pmr::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::pmr::set<std::pmr::string, std::less<>> non_empty_strings(resource);
+    for (const auto& str : strings) {
+        const std::string_view word = str;
+        if (!word.empty()) {
+            non_empty_strings.emplace(word);
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
@@ -0,0 +1,223 @@
+#include "task_scheduler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct CurrentWorker {
+    const TaskScheduler* scheduler = nullptr;
+    size_t queue = 0;
+};
+
+thread_local CurrentWorker current_worker;
+
+}
+
+TaskScheduler::TaskScheduler(size_t thread_count, const vector<int>& cpus) {
+    for (size_t i = 0; i <= thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i] {
+            WorkerLoop(i);
+            });
+#ifdef __linux__
+        if (!cpus.empty()) {
+            const int cpu = cpus[i % cpus.size()];
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            int error = EINVAL;
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpu_set);
+                error = pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set), &cpu_set);
+            }
+            if (error != 0) {
+                {
+                    lock_guard guard(sleep_mutex_);
+                    stopped_ = true;
+                }
+                wake_up_.notify_all();
+                for (thread& worker : threads_) {
+                    worker.join();
+                }
+                throw system_error(error, generic_category(), "Cannot pin worker to CPU "s + to_string(cpu));
+            }
+        }
+#endif
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        lock_guard guard(sleep_mutex_);
+        stopped_ = true;
+    }
+    wake_up_.notify_all();
+    for (thread& worker : threads_) {
+        worker.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::Default() {
+    static TaskScheduler scheduler(max(thread::hardware_concurrency(), 2u) - 1);
+    return scheduler;
+}
+
+size_t TaskScheduler::GetThreadCount() const {
+    return threads_.size();
+}
+
+vector<WorkerStats> TaskScheduler::GetWorkerStats() const {
+    const auto uptime = chrono::steady_clock::now() - start_;
+    vector<WorkerStats> result;
+    result.reserve(threads_.size());
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        const Worker& worker = *workers_[i];
+        WorkerStats stats;
+        stats.tasks = worker.executed.load(memory_order_relaxed);
+        stats.steals = worker.steals.load(memory_order_relaxed);
+        stats.busy_time = chrono::nanoseconds(worker.busy_ns.load(memory_order_relaxed));
+        stats.utilization = uptime.count() > 0 ? static_cast<double>(stats.busy_time.count()) / chrono::nanoseconds(uptime).count() : 0.0;
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void TaskScheduler::Run(Task root) {
+    Job job;
+    root.job = &job;
+    const size_t queue = CurrentQueue();
+    Execute(queue, root);
+    while (job.pending.load(memory_order_acquire) != 0) {
+        Task task;
+        if (TryTake(queue, task)) {
+            // Поток вне планировщика выполняет чужую задачу целиком, не деля её: он уйдёт, как только
+            // завершится его собственное задание, и половины в общей очереди внешних потоков
+            // могли бы остаться там, пока их владелец спит
+            if (queue == threads_.size() && task.job != &job) {
+                task.grain = task.end - task.begin;
+            }
+            Execute(queue, task);
+            continue;
+        }
+        // Все оставшиеся задачи уже выполняются другими потоками
+        unique_lock lock(job.mutex);
+        job.finished.wait(lock, [&job] {
+            return job.pending.load(memory_order_acquire) == 0;
+            });
+    }
+    lock_guard guard(job.mutex);
+    if (job.exception) {
+        rethrow_exception(job.exception);
+    }
+}
+
+void TaskScheduler::WorkerLoop(size_t index) {
+    current_worker = { this, index };
+    Worker& worker = *workers_[index];
+    while (true) {
+        const uint64_t epoch = epoch_.load();
+        Task task;
+        if (TryTake(index, task)) {
+            const auto start = chrono::steady_clock::now();
+            Execute(index, task);
+            worker.busy_ns.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(), memory_order_relaxed);
+            continue;
+        }
+
+        unique_lock lock(sleep_mutex_);
+        ++sleepers_;
+        wake_up_.wait(lock, [this, epoch] {
+            return stopped_ || epoch_.load() != epoch;
+            });
+        --sleepers_;
+        if (stopped_) {
+            return;
+        }
+    }
+}
+
+// Пока задача крупнее grain, правая половина уходит в очередь, левая выполняется дальше
+void TaskScheduler::Execute(size_t queue, Task task) {
+    while (task.end - task.begin > task.grain) {
+        const size_t middle = task.begin + (task.end - task.begin) / 2;
+        task.job->pending.fetch_add(1, memory_order_relaxed);
+        Push(queue, { task.invoke, task.context, middle, task.end, task.grain, task.job });
+        task.end = middle;
+    }
+    if (queue < threads_.size()) {
+        workers_[queue]->executed.fetch_add(1, memory_order_relaxed);
+    }
+    try {
+        task.invoke(task.context, task.begin, task.end);
+    }
+    catch (...) {
+        lock_guard guard(task.job->mutex);
+        if (!task.job->exception) {
+            task.job->exception = current_exception();
+        }
+    }
+    // Если pending == 1, других задач этого Job нет и никто не может его увеличить
+    Job& job = *task.job;
+    size_t pending = job.pending.load(memory_order_acquire);
+    while (pending > 1 && !job.pending.compare_exchange_weak(pending, pending - 1, memory_order_acq_rel)) {
+    }
+    if (pending == 1) {
+        lock_guard guard(job.mutex);
+        job.pending.store(0, memory_order_release);
+        job.finished.notify_all();
+    }
+}
+
+void TaskScheduler::Push(size_t queue, const Task& task) {
+    {
+        Worker& worker = *workers_[queue];
+        lock_guard guard(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+    epoch_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+        lock_guard guard(sleep_mutex_);
+        wake_up_.notify_one();
+    }
+}
+
+bool TaskScheduler::TryTake(size_t queue, Task& task) {
+    {
+        Worker& own = *workers_[queue];
+        lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(queue + offset) % workers_.size()];
+        lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            if (queue < threads_.size()) {
+                workers_[queue]->steals.fetch_add(1, memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TaskScheduler::CurrentQueue() const {
+    return current_worker.scheduler == this ? current_worker.queue : threads_.size();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerStats {
+    size_t tasks = 0;
+    size_t steals = 0;
+    std::chrono::nanoseconds busy_time{ 0 };
+    // Доля времени с запуска планировщика, которую поток выполнял задачи
+    double utilization = 0.0;
+};
+
+// Планировщик с захватом работы. У каждого рабочего потока своя очередь: поток берёт задачи
+// с её конца, свободные потоки крадут с начала чужих очередей. Диапазон ParallelFor делится пополам,
+// пока больше grain, половины становятся доступными для кражи. Поток, вызвавший ParallelFor,
+// сам выполняет задачи, пока их можно взять из очередей, поэтому вложенный ParallelFor не создаёт
+// новых потоков. Когда брать нечего, поток засыпает до завершения последней задачи, а не крутится
+class TaskScheduler {
+public:
+    // cpus - номера процессоров, к которым по кругу привязываются рабочие потоки; пусто - без привязки
+    explicit TaskScheduler(size_t thread_count, const std::vector<int>& cpus = {});
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    ~TaskScheduler();
+
+    // Общий планировщик процесса: по потоку на ядро, кроме ядра вызывающего потока, но не меньше одного
+    static TaskScheduler& Default();
+
+    // body(i) для каждого i из [begin, end). Первое исключение из body пробрасывается вызывающему
+    template <typename Body>
+    void ParallelFor(size_t begin, size_t end, size_t grain, const Body& body) {
+        if (begin >= end) {
+            return;
+        }
+        Run({ [](const void* context, size_t first, size_t last) {
+            const Body& body = *static_cast<const Body*>(context);
+            for (size_t i = first; i < last; ++i) {
+                body(i);
+            }
+            }, &body, begin, end, std::max<size_t>(grain, 1), nullptr });
+    }
+
+    size_t GetThreadCount() const;
+    std::vector<WorkerStats> GetWorkerStats() const;
+
+private:
+    // pending обнуляет последняя задача под mutex: Run не уничтожит Job, пока она его держит
+    struct Job {
+        std::atomic_size_t pending = 1;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr exception;
+    };
+
+    struct Task {
+        void (*invoke)(const void* context, size_t begin, size_t end);
+        const void* context;
+        size_t begin;
+        size_t end;
+        size_t grain;
+        Job* job;
+    };
+
+    // Очередь рабочего потока; последняя очередь - для задач потоков вне планировщика
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic_size_t executed = 0;
+        std::atomic_size_t steals = 0;
+        std::atomic<std::int64_t> busy_ns = 0;
+    };
+
+    void Run(Task root);
+    void WorkerLoop(size_t index);
+    void Execute(size_t queue, Task task);
+    void Push(size_t queue, const Task& task);
+    bool TryTake(size_t queue, Task& task);
+    size_t CurrentQueue() const;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::uint64_t> epoch_ = 0;
+    std::atomic_size_t sleepers_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool stopped_ = false;
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};